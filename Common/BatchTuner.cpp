@@ -0,0 +1,186 @@
+#include "BatchTuner.h"
+#include <iostream>
+#include <algorithm>
+
+BatchTuner::BatchTuner(size_t minimum, size_t maximum, size_t initial)
+: _minimum(std::max<size_t>(minimum, 1))
+, _maximum(std::max(maximum, _minimum))
+, _jobMaximum(_maximum)
+, _size(std::min(std::max(initial, _minimum), _maximum))
+{
+}
+
+void BatchTuner::setJobRows(size_t rows)
+{
+	_jobMaximum = std::min(std::max(rows, _minimum), _maximum);
+	if(_size > _jobMaximum)
+		moveTo(_jobMaximum);
+	// A job no larger than the minimum leaves nothing to choose
+	if(_jobMaximum == _minimum)
+		_phase = Phase::Converged;
+}
+
+void BatchTuner::succeeded(size_t rows, qint64 elapsedMs)
+{
+	_consecutiveFailures = 0;
+	if(rows != _size)
+		return;
+	Probe& probe = _curve[rows];
+	probe.batches++;
+	probe.rows += rows;
+	probe.ms += elapsedMs;
+	if(_phase != Phase::Converged) {
+		if(++_samples >= samplesPerSize)
+			measured();
+	} else if(_overloaded > 0 && ++_successesSinceFailure >= reprobeAfter) {
+		reprobe();
+	}
+}
+
+bool BatchTuner::failed(size_t rows, bool tooLarge)
+{
+	if(++_consecutiveFailures > maxConsecutiveFailures)
+		return false;
+
+	// A refused size stays refused, also when a remainder finds it
+	if(tooLarge) {
+		Probe& probe = _curve[rows];
+		probe.batches++;
+		probe.errors++;
+		if(rows <= _minimum)
+			return false;
+		if(_tooLarge == 0 || rows < _tooLarge)
+			_tooLarge = rows;
+		retreat(rows);
+		std::cout << "Batches of " << rows << " rows are too large, trying " << _size << std::endl << std::flush;
+		return true;
+	}
+
+	// A remainder says nothing about the size, it is sent again as it is
+	if(rows != _size)
+		return true;
+	_successesSinceFailure = 0;
+
+	Probe& probe = _curve[rows];
+	probe.batches++;
+	probe.errors++;
+	if(double(probe.errors) <= maxErrorRate * double(probe.batches))
+		return true;
+	if(rows <= _minimum)
+		return false;
+
+	probe.overloaded = true;
+	if(_overloaded == 0 || rows < _overloaded)
+		_overloaded = rows;
+	retreat(rows);
+	std::cout << "Batches of " << rows << " rows keep failing, trying " << _size << std::endl << std::flush;
+	return true;
+}
+
+// The smallest size known to be worse, or 0.
+size_t BatchTuner::upper() const
+{
+	size_t bound = 0;
+	for(const size_t worse: { _slower, _overloaded, _tooLarge }) {
+		if(worse > 0 && (bound == 0 || worse < bound))
+			bound = worse;
+	}
+	return bound;
+}
+
+// Moves below a size that failed.
+void BatchTuner::retreat(size_t rows)
+{
+	if(_best >= rows)
+		_best = 0;
+	if(_best == 0) {
+		// Nothing smaller is known to work, so start over below the failure
+		_phase = Phase::Grow;
+		moveTo(rows / 2);
+	} else {
+		_phase = Phase::Refine;
+		moveTo((_best + upper()) / 2);
+	}
+}
+
+// Forgets the sizes that failed under load and probes above the best one again.
+// Slower and refused sizes are kept, as is the measured curve.
+void BatchTuner::reprobe()
+{
+	const bool bounded = _overloaded == upper();
+	for(auto& point: _curve)
+		point.second.overloaded = false;
+	_overloaded = 0;
+	_successesSinceFailure = 0;
+	if(!bounded)
+		return;
+	std::cout << "Probing batch sizes above " << _size << " rows again" << std::endl << std::flush;
+	_phase = Phase::Grow;
+	step();
+}
+
+bool BatchTuner::better(size_t size) const
+{
+	const Probe& probe = _curve.at(size);
+	if(probe.overloaded)
+		return false;
+	// Within measurement noise the smaller size wins, it is less likely to hit limits
+	return _best == 0 || probe.rowsPerSecond() > 1.05 * _curve.at(_best).rowsPerSecond();
+}
+
+void BatchTuner::measured()
+{
+	if(better(_size))
+		_best = _size;
+	else if(_size != _best && (_slower == 0 || _size < _slower))
+		_slower = _size;
+	step();
+}
+
+// Picks the next size to measure from the best one and the worse bound.
+void BatchTuner::step()
+{
+	const size_t bound = upper();
+	if(_phase == Phase::Grow && _best == _size) {
+		const size_t next = std::min(_size * 2, _jobMaximum);
+		if(next == _size) {
+			_phase = Phase::Converged;
+			_successesSinceFailure = 0;
+			return;
+		}
+		if(bound == 0 || next < bound) {
+			moveTo(next);
+			return;
+		}
+	}
+
+	_phase = Phase::Refine;
+	const size_t lower = _best > 0 ? _best : _minimum;
+	const size_t upper = bound > 0 ? bound : _jobMaximum;
+	if(upper <= lower || upper - lower <= std::max<size_t>(1, lower / 8)) {
+		_phase = Phase::Converged;
+		_successesSinceFailure = 0;
+		moveTo(lower);
+		std::cout << "Batch size converged on " << _size << " rows" << std::endl << std::flush;
+		return;
+	}
+	moveTo((lower + upper) / 2);
+}
+
+void BatchTuner::moveTo(size_t size)
+{
+	_size = std::min(std::max(size, _minimum), _jobMaximum);
+	_samples = 0;
+}
+
+void BatchTuner::print(const char* name) const
+{
+	std::cout << "Batch size for " << name << ": " << _size << (converged() ? " (converged)" : " (still probing)") << "\n";
+	for(const auto& point: _curve) {
+		const Probe& probe = point.second;
+		std::cout << "\t" << point.first << " rows: " << probe.batches << " batches, " << probe.errors << " errors, "
+			<< qint64(probe.rowsPerSecond()) << " rows/s" << (point.first == _size ? " <-" : "")
+			<< (_tooLarge > 0 && point.first >= _tooLarge ? " (too large)" : "") << "\n";
+	}
+	std::cout << std::flush;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <QtGlobal>
+#include <map>
+
+//
+// Finds the batch size with the highest insert throughput while a load runs.
+//
+// Sizes are first doubled while rows per second keep improving, then the
+// range between the best size and the first worse one is bisected. Once the
+// range is narrow enough the best size is kept.
+//
+// A size can be worse in three ways. It can be slower, which is measured.
+// The backend can refuse it as too large, which holds for the rest of the run.
+// Or its batches can fail too often under load. A single failure of a size
+// that mostly works is usually load rather than size, so it is sent again at
+// the same size. Sizes that failed under load are probed again after a long
+// run of successes, so a spell of overload does not cap the size for good.
+//
+// Every size is measured over a few full batches. Shorter batches, like the
+// remainder at the end of a job, are sent at their own size and not counted.
+// Sizes are kept within the job, so a batch that carries a whole job counts.
+//
+class BatchTuner
+{
+public:
+	BatchTuner(size_t minimum = 1, size_t maximum = 10000, size_t initial = 8);
+
+	// The number of rows to send in the next batch.
+	size_t size() const { return _size; }
+	bool converged() const { return _phase == Phase::Converged; }
+
+	// Keeps the size within a job of this many rows.
+	void setJobRows(size_t rows);
+
+	void succeeded(size_t rows, qint64 elapsedMs);
+	// tooLarge is for a batch the backend refused for its size, otherwise the
+	// failure is taken for load. False when sending again will not help: rows
+	// was already the minimum, or batches kept failing whatever their size.
+	bool failed(size_t rows, bool tooLarge);
+
+	// The chosen size and the measured rows per second of every size tried.
+	void print(const char* name) const;
+
+private:
+	enum class Phase { Grow, Refine, Converged };
+
+	struct Probe {
+		size_t batches = 0;
+		size_t errors = 0;
+		size_t rows = 0;
+		qint64 ms = 0;
+		// Failed too often under load since the last probe of larger sizes
+		bool overloaded = false;
+
+		double rowsPerSecond() const { return ms > 0 ? 1000.0 * double(rows) / double(ms) : 0; }
+	};
+
+	static const size_t samplesPerSize = 3;
+	// More failed batches than this, of those sent at a size, make it worse
+	static constexpr double maxErrorRate = 0.1;
+	static const size_t maxConsecutiveFailures = 8;
+	static const size_t reprobeAfter = 100;
+
+	const size_t _minimum;
+	const size_t _maximum;
+	size_t _jobMaximum;
+	Phase _phase = Phase::Grow;
+	size_t _size;
+	size_t _samples = 0;
+	size_t _consecutiveFailures = 0;
+	size_t _successesSinceFailure = 0;
+	// The best size, and the smallest sizes that were slower, failed under
+	// load or were refused as too large. 0 when there is none.
+	size_t _best = 0;
+	size_t _slower = 0;
+	size_t _overloaded = 0;
+	size_t _tooLarge = 0;
+	std::map<size_t, Probe> _curve;
+
+	size_t upper() const;
+	void measured();
+	void step();
+	void retreat(size_t rows);
+	void reprobe();
+	bool better(size_t size) const;
+	void moveTo(size_t size);
+};
@@ -0,0 +1,355 @@
+#include "CaptureNetworkAccessManager.h"
+#include <QNetworkReply>
+#include <QSslConfiguration>
+#include <QTimer>
+#include <stdexcept>
+#include <iostream>
+
+static const char captureMagic[] = "GreenBitesCapture3";
+
+// A capture is the magic followed by records, in the order they happened.
+// Parts of a body come before the exchange they belong to, aborted exchanges
+// leave parts without one.
+enum class Record : quint8 { Seed = 1, Body = 2, Exchange = 3 };
+
+//
+// A reply that serves its body from a buffer it fills itself.
+//
+class BufferedReply : public QNetworkReply
+{
+public:
+	explicit BufferedReply(QObject* parent)
+	: QNetworkReply(parent)
+	{
+	}
+
+	qint64 bytesAvailable() const override
+	{
+		return _buffer.size() - _position + QNetworkReply::bytesAvailable();
+	}
+
+protected:
+	QByteArray _buffer;
+	int _position = 0;
+
+	void start(QNetworkAccessManager::Operation operation, const QNetworkRequest& request)
+	{
+		setOperation(operation);
+		setRequest(request);
+		setUrl(request.url());
+		open(QIODevice::ReadOnly);
+	}
+
+	void append(const QByteArray& data)
+	{
+		// Drop what was read before, so a long stream does not pile up
+		if(_position == _buffer.size()) {
+			_buffer.clear();
+			_position = 0;
+		}
+		_buffer.append(data);
+	}
+
+	qint64 readData(char* data, qint64 maxSize) override
+	{
+		const qint64 size = std::min(maxSize, qint64(_buffer.size() - _position));
+		if(size <= 0)
+			return isFinished() ? -1 : 0;
+		memcpy(data, _buffer.constData() + _position, size_t(size));
+		_position += int(size);
+		return size;
+	}
+};
+
+//
+// Passes the real reply through and copies the exchange into the capture.
+//
+class RecordingReply : public BufferedReply
+{
+public:
+	RecordingReply(CaptureNetworkAccessManager* manager, quint32 index, QNetworkReply* inner, const CaptureNetworkAccessManager::Exchange& exchange, const QElapsedTimer& clock)
+	: BufferedReply(manager)
+	, _manager(manager)
+	, _index(index)
+	, _inner(inner)
+	, _exchange(exchange)
+	, _clock(clock)
+	{
+		start(inner->operation(), inner->request());
+		inner->setParent(this);
+		QObject::connect(inner, &QNetworkReply::metaDataChanged, this, [this] {
+			copyMetaData();
+			emit metaDataChanged();
+		});
+		QObject::connect(inner, &QNetworkReply::readyRead, this, [this] {
+			drain();
+			emit readyRead();
+		});
+		QObject::connect(inner, &QNetworkReply::uploadProgress, this, &QNetworkReply::uploadProgress);
+		QObject::connect(inner, &QNetworkReply::downloadProgress, this, &QNetworkReply::downloadProgress);
+#ifndef QT_NO_SSL
+		QObject::connect(inner, &QNetworkReply::encrypted, this, &QNetworkReply::encrypted);
+#endif
+		QObject::connect(inner, &QNetworkReply::finished, this, [this] { finish(); });
+	}
+
+	void abort() override
+	{
+		_inner->abort();
+	}
+
+protected:
+#ifndef QT_NO_SSL
+	void sslConfigurationImplementation(QSslConfiguration& configuration) const override
+	{
+		configuration = _inner->sslConfiguration();
+	}
+#endif
+
+private:
+	CaptureNetworkAccessManager* _manager;
+	const quint32 _index;
+	QNetworkReply* _inner;
+	CaptureNetworkAccessManager::Exchange _exchange;
+	const QElapsedTimer& _clock;
+
+	void copyMetaData()
+	{
+		setAttribute(QNetworkRequest::HttpStatusCodeAttribute, _inner->attribute(QNetworkRequest::HttpStatusCodeAttribute));
+		setAttribute(QNetworkRequest::HttpReasonPhraseAttribute, _inner->attribute(QNetworkRequest::HttpReasonPhraseAttribute));
+		for(const auto& header: _inner->rawHeaderPairs())
+			setRawHeader(header.first, header.second);
+	}
+
+	void drain()
+	{
+		const QByteArray data = _inner->readAll();
+		if(data.isEmpty())
+			return;
+		_exchange.bodySize += data.size();
+		_manager->writeBody(_index, data);
+		append(data);
+	}
+
+	void finish()
+	{
+		drain();
+		copyMetaData();
+		setError(_inner->error(), _inner->errorString());
+
+		if(_inner->error() != QNetworkReply::OperationCanceledError) {
+			_exchange.durationMs = _clock.elapsed() - _exchange.startMs;
+			_exchange.status = _inner->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+			_exchange.reason = _inner->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toByteArray();
+			_exchange.headers = _inner->rawHeaderPairs();
+			_exchange.error = _inner->error();
+			_exchange.errorString = _inner->errorString();
+			_manager->writeExchange(_index, _exchange);
+		}
+
+		setFinished(true);
+		emit readChannelFinished();
+		emit finished();
+	}
+};
+
+//
+// Answers a request with a recorded exchange. The body is read from the
+// capture one part at a time, the consumer can read it before the next.
+//
+class ReplayReply : public BufferedReply
+{
+public:
+	ReplayReply(CaptureNetworkAccessManager* manager, QNetworkAccessManager::Operation operation, const QNetworkRequest& request, const CaptureNetworkAccessManager::Exchange& exchange, bool originalTimings)
+	: BufferedReply(manager)
+	, _manager(manager)
+	, _exchange(exchange)
+	{
+		start(operation, request);
+		QTimer::singleShot(originalTimings ? int(exchange.durationMs) : 0, this, [this] { deliver(); });
+	}
+
+	void abort() override
+	{
+		if(isFinished())
+			return;
+		setError(QNetworkReply::OperationCanceledError, "Operation canceled");
+		setFinished(true);
+		emit finished();
+	}
+
+private:
+	CaptureNetworkAccessManager* _manager;
+	const CaptureNetworkAccessManager::Exchange _exchange;
+
+	void deliver()
+	{
+		if(isFinished())
+			return;
+		if(_exchange.status > 0) {
+			setAttribute(QNetworkRequest::HttpStatusCodeAttribute, _exchange.status);
+			setAttribute(QNetworkRequest::HttpReasonPhraseAttribute, _exchange.reason);
+		}
+		for(const auto& header: _exchange.headers)
+			setRawHeader(header.first, header.second);
+		emit metaDataChanged();
+
+		qint64 received = 0;
+		for(const qint64 chunk: _exchange.chunks) {
+			const QByteArray data = _manager->readBody(chunk);
+			received += data.size();
+			append(data);
+			emit downloadProgress(received, _exchange.bodySize);
+			emit readyRead();
+			// The consumer may have given up on the reply
+			if(isFinished())
+				return;
+		}
+		if(_exchange.error != QNetworkReply::NoError)
+			setError(QNetworkReply::NetworkError(_exchange.error), _exchange.errorString);
+		setFinished(true);
+		emit readChannelFinished();
+		emit finished();
+	}
+};
+
+static QDataStream& operator<<(QDataStream& stream, const CaptureNetworkAccessManager::Exchange& e)
+{
+	return stream << e.operation << e.key << e.url << e.requestSize << e.startMs << e.durationMs
+		<< e.status << e.reason << e.headers << e.error << e.errorString << e.bodySize;
+}
+
+static QDataStream& operator>>(QDataStream& stream, CaptureNetworkAccessManager::Exchange& e)
+{
+	return stream >> e.operation >> e.key >> e.url >> e.requestSize >> e.startMs >> e.durationMs
+		>> e.status >> e.reason >> e.headers >> e.error >> e.errorString >> e.bodySize;
+}
+
+void CaptureNetworkAccessManager::record(const QString& path)
+{
+	_file.reset(new QFile(path));
+	if(!_file->open(QIODevice::WriteOnly | QIODevice::Truncate))
+		throw std::runtime_error("Could not write capture " + path.toStdString());
+	_stream.setDevice(_file.get());
+	_stream << QByteArray(captureMagic);
+	_mode = Mode::Record;
+	_path = path;
+	_clock.start();
+}
+
+// Reads the exchanges, but only notes where their bodies are.
+void CaptureNetworkAccessManager::replay(const QString& path, bool originalTimings)
+{
+	_file.reset(new QFile(path));
+	if(!_file->open(QIODevice::ReadOnly))
+		throw std::runtime_error("Could not open capture " + path.toStdString());
+	_stream.setDevice(_file.get());
+	QByteArray magic;
+	_stream >> magic;
+	if(magic != captureMagic)
+		throw std::runtime_error("Not a capture file: " + path.toStdString());
+
+	QHash<quint32, std::vector<qint64>> chunks;
+	quint32 count = 0;
+	while(!_stream.atEnd() && _stream.status() == QDataStream::Ok) {
+		quint8 type = 0;
+		quint32 index = 0;
+		_stream >> type;
+		if(Record(type) == Record::Seed) {
+			_stream >> _seed;
+		} else if(Record(type) == Record::Body) {
+			_stream >> index;
+			chunks[index].push_back(_file->pos());
+			quint32 size = 0;
+			_stream >> size;
+			if(size != 0xFFFFFFFF && _stream.skipRawData(int(size)) != int(size))
+				_stream.setStatus(QDataStream::ReadPastEnd);
+		} else if(Record(type) == Record::Exchange) {
+			Exchange exchange;
+			_stream >> index >> exchange;
+			exchange.chunks = chunks.take(index);
+			_recorded[exchange.key].push_back(exchange);
+			count++;
+		} else {
+			throw std::runtime_error("Capture file is corrupt: " + path.toStdString());
+		}
+	}
+	// A run that ended without saving leaves its last record unfinished
+	if(_stream.status() != QDataStream::Ok) {
+		std::cout << "Capture file is truncated, replaying what is complete" << std::endl << std::flush;
+		_stream.resetStatus();
+	}
+
+	_mode = Mode::Replay;
+	_path = path;
+	_originalTimings = originalTimings;
+	std::cout << "Replaying " << count << " exchanges from " << path.toStdString() << std::endl << std::flush;
+}
+
+void CaptureNetworkAccessManager::setSeed(quint64 seed)
+{
+	_seed = seed;
+	if(_mode == Mode::Record)
+		_stream << quint8(Record::Seed) << seed;
+}
+
+void CaptureNetworkAccessManager::save() const
+{
+	if(_mode != Mode::Record)
+		return;
+	if(!_file->flush() || _stream.status() != QDataStream::Ok)
+		throw std::runtime_error("Could not write capture " + _path.toStdString());
+	std::cout << "Recorded " << _recordedCount << " exchanges to " << _path.toStdString() << std::endl << std::flush;
+}
+
+void CaptureNetworkAccessManager::writeBody(quint32 index, const QByteArray& data)
+{
+	_stream << quint8(Record::Body) << index << qCompress(data, 1);
+}
+
+void CaptureNetworkAccessManager::writeExchange(quint32 index, const Exchange& exchange)
+{
+	_stream << quint8(Record::Exchange) << index << exchange;
+	_recordedCount++;
+}
+
+QByteArray CaptureNetworkAccessManager::readBody(qint64 position)
+{
+	QByteArray data;
+	if(!_file->seek(position))
+		throw std::runtime_error("Could not read capture " + _path.toStdString());
+	_stream >> data;
+	if(_stream.status() != QDataStream::Ok)
+		throw std::runtime_error("Capture file is truncated: " + _path.toStdString());
+	return qUncompress(data);
+}
+
+QByteArray CaptureNetworkAccessManager::key(Operation operation, const QNetworkRequest& request)
+{
+	return QByteArray::number(int(operation)) + " " + request.url().path(QUrl::FullyEncoded).toUtf8() + " " + request.rawHeader("Range");
+}
+
+QNetworkReply* CaptureNetworkAccessManager::createRequest(Operation operation, const QNetworkRequest& request, QIODevice* outgoingData)
+{
+	if(_mode == Mode::Replay) {
+		auto recorded = _recorded.find(key(operation, request));
+		if(recorded == _recorded.end() || recorded->empty())
+			throw std::runtime_error("No recorded response for " + request.url().toString().toStdString());
+		const Exchange exchange = recorded->front();
+		recorded->pop_front();
+		return new ReplayReply(this, operation, request, exchange, _originalTimings);
+	}
+
+	// Prewarmed connections carry no exchange
+	QNetworkReply* reply = QNetworkAccessManager::createRequest(operation, request, outgoingData);
+	if(_mode == Mode::Off || request.url().scheme().startsWith("preconnect"))
+		return reply;
+
+	Exchange exchange;
+	exchange.operation = qint32(operation);
+	exchange.key = key(operation, request);
+	exchange.url = request.url().toEncoded();
+	exchange.requestSize = outgoingData ? outgoingData->size() : 0;
+	exchange.startMs = _clock.elapsed();
+	return new RecordingReply(this, _started++, reply, exchange, _clock);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <QtGlobal>
+#include <QNetworkAccessManager>
+#include <QElapsedTimer>
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <deque>
+#include <memory>
+#include <vector>
+
+//
+// A QNetworkAccessManager that can record every exchange to a capture file,
+// or answer every request from one without touching the network.
+//
+// Replies are matched by operation, path and range, in the order they were
+// sent, so pages whose query depends on timing still find their response.
+// Request bodies and headers are not recorded, they carry the credentials.
+// Aborted attempts are not recorded either, so a replay without hedging or
+// deadlines sees the same sequence of answers.
+//
+// Paths hold generated names, so the capture also keeps the seed of the
+// run, which a replay has to generate the same names with.
+//
+// Exchanges are written to the file while they arrive, and a replay reads
+// the bodies back from it when they are delivered, so neither holds more
+// than the exchange headers in memory, whatever the size of the downloads.
+//
+class CaptureNetworkAccessManager : public QNetworkAccessManager
+{
+public:
+	struct Exchange {
+		qint32 operation = 0;
+		QByteArray key;
+		QByteArray url;
+		qint64 requestSize = 0;
+		qint64 startMs = 0;
+		qint64 durationMs = 0;
+		qint32 status = 0;
+		QByteArray reason;
+		QList<QPair<QByteArray, QByteArray>> headers;
+		qint32 error = 0;
+		QString errorString;
+		qint64 bodySize = 0;
+		// Where the parts of the body are in the capture, when replaying
+		std::vector<qint64> chunks;
+	};
+
+	void record(const QString& path);
+	void replay(const QString& path, bool originalTimings);
+	bool replaying() const { return _mode == Mode::Replay; }
+
+	// The seed recorded with the exchanges, or read by replay().
+	void setSeed(quint64 seed);
+	quint64 seed() const { return _seed; }
+
+	// Flushes the capture, when recording.
+	void save() const;
+
+	// Written by the recording replies: parts of a body while they arrive,
+	// then the rest of the exchange once it completed.
+	void writeBody(quint32 index, const QByteArray& data);
+	void writeExchange(quint32 index, const Exchange& exchange);
+	QByteArray readBody(qint64 position);
+
+protected:
+	QNetworkReply* createRequest(Operation operation, const QNetworkRequest& request, QIODevice* outgoingData = nullptr) override;
+
+private:
+	enum class Mode { Off, Record, Replay };
+
+	Mode _mode = Mode::Off;
+	QString _path;
+	bool _originalTimings = false;
+	quint64 _seed = 0;
+	QElapsedTimer _clock;
+	std::unique_ptr<QFile> _file;
+	QDataStream _stream;
+	quint32 _started = 0;
+	quint32 _recordedCount = 0;
+	QHash<QByteArray, std::deque<Exchange>> _recorded;
+
+	static QByteArray key(Operation operation, const QNetworkRequest& request);
+};
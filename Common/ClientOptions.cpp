@@ -0,0 +1,63 @@
+#include "ClientOptions.h"
+#include "JexiaClient.h"
+#include "Tracer.h"
+#include <stdexcept>
+
+ClientOptions::ClientOptions(QCommandLineParser& parser)
+: _parser(parser)
+, _timeout("timeout", "Abort a request attempt after this many milliseconds", "ms")
+, _retries("retries", "Retry GET and DELETE requests this many times", "count")
+, _hedge("hedge", "Duplicate page reads that take longer than the p95 latency")
+, _prewarm("prewarm", "Open encrypted connections while authenticating, one for HTTP/2, up to 6 for HTTP/1.1", "count")
+, _tlsSession("tlssession", "Resume the TLS session saved in this file, and save the new one", "path")
+, _trace("trace", "Write a Chrome trace of all requests and jobs to this file", "path")
+, _record("record", "Record all HTTP exchanges to this capture file", "path")
+, _replay("replay", "Answer all HTTP requests from this capture file", "path")
+, _replayTimed("replaytimed", "Replay with the recorded response times")
+{
+	parser.addOptions({ _timeout, _retries, _hedge, _prewarm, _tlsSession, _trace, _record, _replay, _replayTimed });
+}
+
+void ClientOptions::startTracing() const
+{
+	if(_parser.isSet(_trace))
+		Tracer::instance().start(_parser.value(_trace));
+}
+
+void ClientOptions::apply(JexiaClient& client, int index) const
+{
+	if(_parser.isSet(_record) && _parser.isSet(_replay))
+		throw std::runtime_error("Cannot record and replay at the same time");
+	if(_parser.isSet(_record))
+		client.record(path(_record, index));
+	if(_parser.isSet(_replay))
+		client.replay(path(_replay, index), _parser.isSet(_replayTimed));
+
+	JexiaClient::RequestPolicy policy;
+	if(_parser.isSet(_timeout))
+		policy.timeoutMs = number(_timeout);
+	if(_parser.isSet(_retries))
+		policy.maxAttempts = 1 + number(_retries);
+	policy.hedge = _parser.isSet(_hedge);
+	client.setRequestPolicy(policy);
+
+	if(_parser.isSet(_prewarm))
+		client.setPrewarmConnections(number(_prewarm));
+	if(_parser.isSet(_tlsSession))
+		client.setTlsSessionFile(path(_tlsSession, index));
+}
+
+QString ClientOptions::path(const QCommandLineOption& option, int index) const
+{
+	const QString path = _parser.value(option);
+	return index < 0 ? path : path + "." + QString::number(index);
+}
+
+int ClientOptions::number(const QCommandLineOption& option) const
+{
+	bool ok = true;
+	const int result = _parser.value(option).toInt(&ok);
+	if(!ok)
+		throw std::runtime_error("Could not parse " + option.names().first().toStdString());
+	return result;
+}
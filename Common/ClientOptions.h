@@ -0,0 +1,41 @@
+#pragma once
+#include <QtGlobal>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+
+class JexiaClient;
+
+//
+// The command line options of the client plumbing, shared by the generators:
+// deadlines, retries and hedging, connection setup, tracing, record and replay.
+//
+// Construct it before parsing, so the options are registered, then call
+// startTracing() before the first client or work queue exists, and apply()
+// to every client.
+//
+class ClientOptions
+{
+public:
+	explicit ClientOptions(QCommandLineParser& parser);
+
+	void startTracing() const;
+
+	// With several clients, every one gets its own capture and TLS session
+	// file, with the index appended.
+	void apply(JexiaClient& client, int index = -1) const;
+
+private:
+	const QCommandLineParser& _parser;
+	const QCommandLineOption _timeout;
+	const QCommandLineOption _retries;
+	const QCommandLineOption _hedge;
+	const QCommandLineOption _prewarm;
+	const QCommandLineOption _tlsSession;
+	const QCommandLineOption _trace;
+	const QCommandLineOption _record;
+	const QCommandLineOption _replay;
+	const QCommandLineOption _replayTimed;
+
+	QString path(const QCommandLineOption& option, int index) const;
+	int number(const QCommandLineOption& option) const;
+};
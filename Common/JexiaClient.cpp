@@ -0,0 +1,673 @@
+#include "JexiaClient.h"
+#include "Tracer.h"
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QTimer>
+#include <QRandomGenerator>
+#include <QDateTime>
+#include <QDataStream>
+#include <QFile>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <string>
+
+// The client sets abortReason on a reply it aborts on purpose.
+static QString reason(QNetworkReply* reply)
+{
+	const QString abortReason = reply->property("abortReason").toString();
+	if(!abortReason.isEmpty())
+		return abortReason;
+	if(reply->property("deadlineExceeded").toBool())
+		return "deadline exceeded";
+	const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	return status > 0 ? "HTTP " + QString::number(status) : reply->errorString();
+}
+
+static QString describe(const QString& operation, QNetworkReply* reply)
+{
+	// An aborted reply only says it was canceled
+	const QString detail = reply->error() == QNetworkReply::OperationCanceledError ? reason(reply) : reply->errorString();
+	return "HTTP " + operation + " Request failed (" + QString::number(reply->error()) + "): " + detail;
+}
+
+JexiaError::JexiaError(const QString& operation, QNetworkReply* reply)
+: std::runtime_error(describe(operation, reply).toStdString())
+, _networkError(reply->error())
+, _httpStatus(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt())
+, _reason(reason(reply))
+, _url(reply->request().url())
+, _body(reply->readAll())
+{
+}
+
+JexiaClient::JexiaClient(const QString& jexiaProjectUrl, const QString& jexiaKey, const QString& jexiaSecret)
+: _baseUrl(jexiaProjectUrl.toUtf8())
+, _jexiaKey(jexiaKey)
+, _jexiaSecret(jexiaSecret)
+{
+	QObject::connect(&_nam, &QNetworkAccessManager::authenticationRequired, [] {
+		std::cout << "QNetworkAccessManager::authenticationRequired - 100" << std::endl << std::flush;
+	});
+	_refreshTimer.setSingleShot(true);
+	QObject::connect(&_refreshTimer, &QTimer::timeout, [this] { refresh([] {}); });
+
+	// Pipelining and HTTP/2 are requested here, for every request at once.
+	_getRequest.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+	_getRequest.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+	_postRequest = _getRequest;
+	_postRequest.setHeader(QNetworkRequest::ContentTypeHeader, QVariant("application/x-www-form-urlencoded"));
+
+#ifndef QT_NO_SSL
+	// Requests report their own handshakes, prewarmed connections only report to the manager
+	QObject::connect(&_nam, &QNetworkAccessManager::encrypted, [this] (QNetworkReply* reply) {
+		if(reply->url().scheme().startsWith("preconnect")) {
+			_statistics.prewarmHandshakes++;
+			handshakeCompleted(reply, _prewarmTimer.elapsed());
+		}
+	});
+#endif
+}
+
+void JexiaClient::setPrewarmConnections(int connections)
+{
+	_prewarmConnections = connections;
+}
+
+// The ticket file holds the host, the expiry time and the ticket.
+void JexiaClient::setTlsSessionFile(const QString& path)
+{
+#ifndef QT_NO_SSL
+	_tlsSessionFile = path;
+	QSslConfiguration configuration = QSslConfiguration::defaultConfiguration();
+	configuration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+
+	QFile file(path);
+	if(file.open(QIODevice::ReadOnly)) {
+		QDataStream stream(&file);
+		QString host;
+		qint64 expires = 0;
+		QByteArray ticket;
+		stream >> host >> expires >> ticket;
+		const bool valid = stream.status() == QDataStream::Ok && host == QUrl::fromEncoded(_baseUrl).host()
+			&& expires > QDateTime::currentSecsSinceEpoch() && !ticket.isEmpty();
+		if(valid) {
+			std::cout << "Resuming the TLS session saved in " << path.toStdString() << std::endl << std::flush;
+			configuration.setSessionTicket(ticket);
+		}
+	}
+
+	_getRequest.setSslConfiguration(configuration);
+	_postRequest.setSslConfiguration(configuration);
+#else
+	Q_UNUSED(path);
+	std::cout << "Built without TLS, not keeping sessions" << std::endl << std::flush;
+#endif
+}
+
+// A lifetime hint of 0 means the server did not say, then the ticket is kept
+// for as long as servers commonly accept one. A stale ticket only costs a
+// full handshake.
+static const int defaultTicketLifetime = 7200;
+
+void JexiaClient::saveTlsSession() const
+{
+	if(_tlsSessionFile.isEmpty() || _sessionTicket.isEmpty())
+		return;
+	QFile file(_tlsSessionFile);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		throw std::runtime_error("Could not write TLS session " + _tlsSessionFile.toStdString());
+	QDataStream stream(&file);
+	const int lifetime = _sessionLifetime > 0 ? _sessionLifetime : defaultTicketLifetime;
+	stream << QUrl::fromEncoded(_baseUrl).host() << qint64(QDateTime::currentSecsSinceEpoch() + lifetime) << _sessionTicket;
+}
+
+// Connections only help before the first requests when they are encrypted,
+// plain ones are cheap to open on demand. Requests allow HTTP/2, and Qt keeps
+// those connections apart from HTTP/1.1 ones, so the preconnect has to offer
+// h2 by ALPN to be picked up. One HTTP/2 connection carries all requests,
+// Qt ignores further HTTP/2 preconnects to the same host.
+void JexiaClient::prewarm()
+{
+#ifndef QT_NO_SSL
+	const QUrl url = QUrl::fromEncoded(_baseUrl);
+	if(_prewarmConnections <= 0 || url.scheme() != "https" || _nam.replaying())
+		return;
+	QSslConfiguration configuration = _getRequest.sslConfiguration();
+	int connections = std::min(_prewarmConnections, 6);
+	if(_getRequest.attribute(QNetworkRequest::Http2AllowedAttribute).toBool()) {
+		configuration.setAllowedNextProtocols({ QSslConfiguration::ALPNProtocolHTTP2, QSslConfiguration::NextProtocolHttp1_1 });
+		connections = 1;
+	}
+	std::cout << "Prewarming " << connections << " connections" << std::endl << std::flush;
+	_prewarmTimer.start();
+	for(int i=0; i < connections; i++)
+		_nam.connectToHostEncrypted(url.host(), quint16(url.port(443)), configuration);
+#endif
+}
+
+void JexiaClient::handshakeCompleted(QNetworkReply* reply, qint64 elapsed)
+{
+	_statistics.handshakes++;
+	_statistics.handshakeMs += elapsed;
+	keepSessionTicket(reply);
+}
+
+// TLS 1.3 servers send tickets after the handshake, so they are looked for
+// again when replies finish, and the newest one is kept.
+void JexiaClient::keepSessionTicket(QNetworkReply* reply)
+{
+#ifndef QT_NO_SSL
+	if(_tlsSessionFile.isEmpty())
+		return;
+	const QSslConfiguration configuration = reply->sslConfiguration();
+	if(!configuration.sessionTicket().isEmpty()) {
+		_sessionTicket = configuration.sessionTicket();
+		_sessionLifetime = configuration.sessionTicketLifeTimeHint();
+	}
+#else
+	Q_UNUSED(reply);
+#endif
+}
+
+// Called on every attempt, so an attempt after a token refresh carries the new token.
+QNetworkRequest JexiaClient::request(const QNetworkRequest& prototype, const QByteArray& path) const
+{
+	QNetworkRequest result(prototype);
+	result.setUrl(QUrl::fromEncoded(_baseUrl + path));
+	return result;
+}
+
+void JexiaClient::setAccessToken(const QByteArray& accessToken)
+{
+	_accessToken = accessToken;
+	const QByteArray authorization = "Bearer " + _accessToken;
+	_getRequest.setRawHeader("Authorization", authorization);
+	_postRequest.setRawHeader("Authorization", authorization);
+}
+
+void JexiaClient::authenticate(std::function<void(void)> done)
+{
+	std::cout << "Authenticating\n" << std::flush;
+	prewarm();
+
+	// Send an authentication request.
+	QJsonObject object {
+		{"method", "apk"},
+		{"key", _jexiaKey},
+		{"secret", _jexiaSecret},
+	};
+
+	QNetworkRequest authRequest = request(_postRequest, "/auth");
+	authRequest.setRawHeader("Authorization", QByteArray());
+	const QByteArray data = QJsonDocument(object).toJson();
+	// Authenticating twice only hands out a second token pair, so it may be retried.
+	execute(Call{ "POST", true, false, false, [this, authRequest, data] { return _nam.post(authRequest, data); }, [this, done] (QNetworkReply* reply) {
+		setTokens(reply);
+		std::cout << "Authenticated\n" << std::flush;
+		done();
+	}, nullptr, true });
+}
+
+void JexiaClient::setTokens(QNetworkReply* reply)
+{
+	auto doc = QJsonDocument::fromJson(reply->readAll());
+	if(!doc.isObject())
+		throw std::runtime_error("Authentication reply is not a JSON object");
+	const auto object = doc.object();
+	if(!object.contains("access_token"))
+		throw std::runtime_error("Authentication JSON object must contain access_token");
+	if(!object.contains("refresh_token"))
+		throw std::runtime_error("Authentication JSON object must contain refresh_token");
+	const QByteArray accessToken = object.value("access_token").toString().toUtf8();
+	_refreshToken = object.value("refresh_token").toString().toUtf8();
+	if(accessToken.isEmpty() || _refreshToken.isEmpty())
+		throw std::runtime_error("One of the tokens is empty");
+	setAccessToken(accessToken);
+
+	// Refresh a minute before the token expires, if it says when. A replay
+	// runs faster than the recording and never needs to. A token that lives
+	// shorter, or a local clock ahead of the server's, refreshes halfway,
+	// but never sooner than a few seconds, which would refresh in a loop.
+	const QList<QByteArray> parts = accessToken.split('.');
+	if(parts.size() != 3 || _nam.replaying())
+		return;
+	const QByteArray payload = QByteArray::fromBase64(parts[1], QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+	const qint64 expires = qint64(QJsonDocument::fromJson(payload).object().value("exp").toDouble());
+	if(expires <= 0)
+		return;
+	static const qint64 minimumRefreshDelay = 5;
+	const qint64 remaining = expires - QDateTime::currentSecsSinceEpoch();
+	const qint64 delay = std::max({ remaining - 60, remaining / 2, minimumRefreshDelay }) * 1000;
+	_refreshTimer.start(int(std::min<qint64>(delay, std::numeric_limits<int>::max())));
+}
+
+// Calls that were refused while the token is refreshed wait in _waitingForToken.
+void JexiaClient::refresh(std::function<void(void)> then)
+{
+	_waitingForToken.push_back(then);
+	if(_waitingForToken.size() > 1)
+		return;
+
+	std::cout << "Refreshing the access token\n" << std::flush;
+	_statistics.refreshes++;
+	QNetworkRequest refreshRequest = request(_postRequest, "/auth/refresh");
+	refreshRequest.setRawHeader("Authorization", QByteArray());
+	const QByteArray data = QJsonDocument(QJsonObject { {"refresh_token", QString::fromUtf8(_refreshToken)} }).toJson();
+	// A refresh token is used up by the first answer, so this is not retried.
+	execute(Call{ "POST", false, false, false, [this, refreshRequest, data] { return _nam.post(refreshRequest, data); }, [this] (QNetworkReply* reply) {
+		setTokens(reply);
+		std::vector<std::function<void(void)>> waiting;
+		waiting.swap(_waitingForToken);
+		for(const auto& call: waiting)
+			call();
+	}, nullptr, true });
+}
+
+void JexiaClient::setRequestPolicy(const RequestPolicy& policy)
+{
+	_policy = policy;
+}
+
+void JexiaClient::record(const QString& path)
+{
+	_nam.record(path);
+}
+
+void JexiaClient::replay(const QString& path, bool originalTimings)
+{
+	_nam.replay(path, originalTimings);
+}
+
+void JexiaClient::saveCapture() const
+{
+	_nam.save();
+}
+
+quint64 JexiaClient::captureSeed(quint64 seed, bool given)
+{
+	if(!_nam.replaying()) {
+		_nam.setSeed(seed);
+		return seed;
+	}
+	if(given && seed != _nam.seed())
+		throw std::runtime_error("The capture was recorded with seed " + std::to_string(_nam.seed()) + ", not " + std::to_string(seed));
+	return _nam.seed();
+}
+
+std::function<QNetworkReply*(void)> JexiaClient::getter(const QByteArray& path)
+{
+	return [this, path] { return _nam.get(request(_getRequest, path)); };
+}
+
+void JexiaClient::execute(Call call)
+{
+	startAttempt(std::make_shared<Call>(std::move(call)), false);
+}
+
+void JexiaClient::startAttempt(std::shared_ptr<Call> call, bool hedge)
+{
+	if(!hedge)
+		call->attempts++;
+	_statistics.requests++;
+	QNetworkReply* reply = call->send();
+	reply->setProperty("hedge", hedge);
+	call->replies.push_back(reply);
+	if(Tracer::enabled())
+		traceAttempt(call->operation, reply);
+	QElapsedTimer timer;
+	timer.start();
+#ifndef QT_NO_SSL
+	QObject::connect(reply, &QNetworkReply::encrypted, [this, reply, timer] {
+		handshakeCompleted(reply, timer.elapsed());
+	});
+#endif
+
+	// The deadline aborts the attempt. Request bodies and streams only time
+	// out when they stall, so a large upload or download may take longer.
+	if(_policy.timeoutMs > 0) {
+		QTimer* deadline = new QTimer(reply);
+		deadline->setSingleShot(true);
+		QObject::connect(deadline, &QTimer::timeout, reply, [reply] {
+			reply->setProperty("deadlineExceeded", true);
+			reply->abort();
+		});
+		QObject::connect(reply, &QNetworkReply::uploadProgress, deadline, [deadline, timeoutMs = _policy.timeoutMs] (qint64 sent, qint64) {
+			if(sent > 0)
+				deadline->start(timeoutMs);
+		});
+		if(call->streaming) {
+			QObject::connect(reply, &QNetworkReply::readyRead, deadline, [deadline, timeoutMs = _policy.timeoutMs] {
+				deadline->start(timeoutMs);
+			});
+		}
+		deadline->start(_policy.timeoutMs);
+	}
+
+	// A hedge is a second copy of the attempt, the first reply wins.
+	// A replay has one recorded answer per request, so it is never hedged.
+	if(_policy.hedge && call->hedged && call->idempotent && !hedge && !_nam.replaying()) {
+		const qint64 threshold = latencyPercentile(0.95);
+		if(threshold > 0) {
+			QTimer::singleShot(int(threshold), reply, [this, call, reply] {
+				if(call->done || std::find(call->replies.begin(), call->replies.end(), reply) == call->replies.end())
+					return;
+				_statistics.hedges++;
+				startAttempt(call, true);
+			});
+		}
+	}
+
+	QObject::connect(reply, &QNetworkReply::finished, [this, call, reply, timer] {
+		finishAttempt(call, reply, timer.elapsed());
+	});
+}
+
+void JexiaClient::finishAttempt(std::shared_ptr<Call> call, QNetworkReply* reply, qint64 elapsed)
+{
+	QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> r(reply);
+	keepSessionTicket(reply);
+	call->replies.erase(std::find(call->replies.begin(), call->replies.end(), reply));
+	// The loser of a hedge, cancelled below
+	if(call->done)
+		return;
+
+	_statistics.latencyMs += elapsed;
+	if(!reply->isFinished())
+		throw std::runtime_error("HTTP Reply is not finished");
+	if(reply->isRunning())
+		throw std::runtime_error("HTTP Reply is still running");
+
+	if(reply->error() == QNetworkReply::NoError) {
+		call->done = true;
+		if(reply->property("hedge").toBool())
+			_statistics.hedgeWins++;
+		const std::vector<QNetworkReply*> losers = call->replies;
+		for(QNetworkReply* loser: losers)
+			loser->abort();
+		if(!call->streaming && qstrcmp(call->operation, "GET") == 0)
+			recordLatency(elapsed);
+		_statistics.bytesReceived += quint64(reply->bytesAvailable());
+		if(Tracer::enabled()) {
+			Tracer& tracer = Tracer::instance();
+			const qint64 begin = tracer.now();
+			call->replyParser(reply);
+			tracer.complete("handle reply", "http", begin, tracer.now());
+		} else {
+			call->replyParser(reply);
+		}
+		return;
+	}
+
+	const bool timedOut = reply->property("deadlineExceeded").toBool();
+	if(timedOut)
+		_statistics.timeouts++;
+	// The other copy of a hedged attempt may still answer
+	if(!call->replies.empty())
+		return;
+
+	// An expired token refuses the request before it is applied, so any call
+	// can be sent again once. Streams may have handed the refusal on already.
+	const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	if(status == 401 && !call->refreshed && !call->streaming && !_refreshToken.isEmpty()) {
+		call->refreshed = true;
+		refresh([this, call] { startAttempt(call, false); });
+		return;
+	}
+
+	if(call->idempotent && call->attempts < _policy.maxAttempts && isRetryable(reply)) {
+		const int delay = backoff(call->attempts);
+		_statistics.retries++;
+		std::cout << "Retrying HTTP " << call->operation << " " << reply->url().toString().toStdString()
+			<< " in " << delay << " ms after: " << (timedOut ? "deadline exceeded" : reply->errorString().toStdString()) << std::endl << std::flush;
+		QTimer::singleShot(delay, this, [this, call] { startAttempt(call, false); });
+		return;
+	}
+
+	_statistics.failures++;
+	const JexiaError error(call->operation, reply);
+	if(call->failed) {
+		call->failed(error);
+		return;
+	}
+	std::cout << "HTTP " << call->operation << " Request failed: \n" << std::endl;
+	std::cout << "Url: " << error.url().toString().toStdString() << "\n";
+	std::cout << QString::fromUtf8(error.body()).toStdString() << std::endl << std::flush;
+	std::cout << "Status code: " << error.httpStatus() << "\n";
+	if(timedOut)
+		std::cout << "Deadline of " << _policy.timeoutMs << " ms exceeded\n";
+	throw error;
+}
+
+// The phases of one attempt. Qt does not report name resolution on its own,
+// so it is part of the connect span, which only new TLS connections have.
+void JexiaClient::traceAttempt(const char* operation, QNetworkReply* reply)
+{
+	struct Phases {
+		qint64 sent;
+		qint64 encrypted;
+		qint64 headers;
+	};
+	auto phases = std::make_shared<Phases>(Phases{ Tracer::instance().now(), -1, -1 });
+#ifndef QT_NO_SSL
+	QObject::connect(reply, &QNetworkReply::encrypted, [phases] {
+		phases->encrypted = Tracer::instance().now();
+	});
+#endif
+	QObject::connect(reply, &QNetworkReply::metaDataChanged, [phases] {
+		if(phases->headers < 0)
+			phases->headers = Tracer::instance().now();
+	});
+	QObject::connect(reply, &QNetworkReply::finished, [operation, reply, phases] {
+		Tracer& tracer = Tracer::instance();
+		const qint64 end = tracer.now();
+		const quint64 id = tracer.nextId();
+		tracer.async(operation, "http", id, phases->sent, end, reply->url().toEncoded());
+		qint64 waiting = phases->sent;
+		if(phases->encrypted >= 0) {
+			tracer.async("connect and TLS handshake", "http", id, phases->sent, phases->encrypted);
+			waiting = phases->encrypted;
+		}
+		const qint64 headers = phases->headers >= 0 ? phases->headers : end;
+		tracer.async("waiting for server", "http", id, waiting, headers);
+		tracer.async("body download", "http", id, headers, end);
+	});
+}
+
+// Server errors, throttling and failures below HTTP are worth another try.
+bool JexiaClient::isRetryable(QNetworkReply* reply) const
+{
+	const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	if(status > 0)
+		return status >= 500 || status == 429 || status == 408;
+	return reply->error() != QNetworkReply::OperationCanceledError || reply->property("deadlineExceeded").toBool();
+}
+
+// Exponential backoff with equal jitter, so retrying clients spread out.
+int JexiaClient::backoff(int attempt) const
+{
+	const qint64 ceiling = std::min<qint64>(qint64(_policy.backoffMs) << std::min(attempt - 1, 20), _policy.maxBackoffMs);
+	return int(ceiling / 2 + QRandomGenerator::global()->bounded(ceiling / 2 + 1));
+}
+
+void JexiaClient::recordLatency(qint64 latency)
+{
+	static const size_t window = 256;
+	if(_latencies.size() < window) {
+		_latencies.push_back(latency);
+	} else {
+		_latencies[_latencyIndex] = latency;
+		_latencyIndex = (_latencyIndex + 1) % window;
+	}
+}
+
+// Returns 0 until there are enough samples to trust the percentile.
+qint64 JexiaClient::latencyPercentile(double percentile) const
+{
+	static const size_t minimumSamples = 20;
+	if(_latencies.size() < minimumSamples)
+		return 0;
+	std::vector<qint64> latencies = _latencies;
+	const auto nth = latencies.begin() + std::ptrdiff_t(percentile * (latencies.size() - 1));
+	std::nth_element(latencies.begin(), nth, latencies.end());
+	return *nth;
+}
+
+void JexiaClient::get(const QByteArray& path, std::function<void(QNetworkReply*)> replyParser)
+{
+	execute(Call{ "GET", true, false, false, getter(path), replyParser });
+}
+
+void JexiaClient::post(const QByteArray& path, const QByteArray& data, std::function<void(QNetworkReply*)> replyParser)
+{
+	_statistics.bytesSent += quint64(data.size());
+	execute(Call{ "POST", false, false, false, [this, path, data] { return _nam.post(request(_postRequest, path), data); }, replyParser });
+}
+
+void JexiaClient::post(const QByteArray& path, const QByteArray& data, std::function<void(QNetworkReply*)> replyParser, std::function<void(const JexiaError&)> failed)
+{
+	_statistics.bytesSent += quint64(data.size());
+	execute(Call{ "POST", false, false, false, [this, path, data] { return _nam.post(request(_postRequest, path), data); }, replyParser, failed });
+}
+
+void JexiaClient::deleteResource(const QByteArray& path, std::function<void(QNetworkReply*)> replyParser)
+{
+	execute(Call{ "DELETE", true, false, false, [this, path] { return _nam.deleteResource(request(_getRequest, path)); }, replyParser });
+}
+
+// Downloads are not retried, because part of the body may already be consumed.
+void JexiaClient::download(const QByteArray& path, qint64 offset, qint64 length, std::function<void(const QByteArray&)> onData, std::function<void(void)> finished, std::function<void(const JexiaError&)> failed)
+{
+	static const qint64 readBufferSize = 1048576;
+
+	QNetworkRequest downloadRequest = request(_getRequest, path);
+	if(length > 0)
+		downloadRequest.setRawHeader("Range", "bytes=" + QByteArray::number(offset) + "-" + QByteArray::number(offset + length - 1));
+
+	const auto drain = [onData] (QNetworkReply* reply) {
+		quint64 size = 0;
+		const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+		if(status < 200 || status >= 300)
+			return size;
+		while(reply->bytesAvailable() > 0) {
+			const QByteArray data = reply->read(readBufferSize);
+			size += quint64(data.size());
+			onData(data);
+		}
+		return size;
+	};
+	const auto send = [this, downloadRequest, length, drain] {
+		QNetworkReply* reply = _nam.get(downloadRequest);
+		reply->setReadBufferSize(readBufferSize);
+		QObject::connect(reply, &QNetworkReply::metaDataChanged, [reply, length] {
+			// A server that ignores the range sends the whole file, which would not line up
+			const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+			if(length > 0 && status == 200 && reply->isRunning()) {
+				reply->setProperty("abortReason", "server ignored the range request");
+				reply->abort();
+			}
+		});
+		QObject::connect(reply, &QNetworkReply::readyRead, [this, reply, drain] {
+			_statistics.bytesReceived += drain(reply);
+		});
+		return reply;
+	};
+	// What is left when the reply finishes is counted by finishAttempt
+	execute(Call{ "GET", false, false, true, send, [drain, finished] (QNetworkReply* reply) {
+		drain(reply);
+		finished();
+	}, failed });
+}
+
+// Page size bounds of getRawArray. The size of the next page is scaled by how far
+// the last page was from the target response time and payload size.
+static const int minimumPageSize = 100;
+static const int initialPageSize = 1000;
+static const int maximumPageSize = 10000;
+static const qint64 targetPageMs = 500;
+static const qint64 targetPageBytes = 4 * 1048576;
+
+void JexiaClient::getRawArray(const QByteArray& path, std::function<Page(const QByteArray&)> decode, std::function<void(void)> finally)
+{
+	getPage(std::make_shared<Scan>(Scan{ path, decode, finally, QString(), initialPageSize }));
+}
+
+// Keyset pagination: every page asks for the rows with an id after the last
+// one seen, ordered by id, so the backend never skips rows like an offset does.
+// cond=[{"field":"id"},">","<last id>"]&order={"direction":"asc","fields":["id"]}&range={"limit": 1000}
+void JexiaClient::getPage(std::shared_ptr<Scan> scan)
+{
+	std::cout << "getRawArray (" << scan->path.toStdString() << ", " << scan->lastId.toStdString() << ", " << scan->limit << ")" << std::endl << std::flush;
+
+	static const QByteArray order = QByteArray("{\"direction\":\"asc\",\"fields\":[\"id\"]}").toPercentEncoding();
+	QByteArray pagePath = scan->path + "?order=" + order
+		+ "&range=" + ("{\"limit\":" + QByteArray::number(scan->limit) + "}").toPercentEncoding();
+	if(!scan->lastId.isEmpty()) {
+		const QJsonArray condition { QJsonObject {{"field", "id"}}, ">", scan->lastId };
+		pagePath += "&cond=" + QJsonDocument(condition).toJson(QJsonDocument::Compact).toPercentEncoding();
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	execute(Call{ "GET", true, true, false, getter(pagePath), [this, scan, timer] (QNetworkReply* reply) {
+		const QByteArray result = reply->readAll();
+		const qint64 elapsed = std::max<qint64>(timer.elapsed(), 1);
+		const qint64 decodeBegin = Tracer::enabled() ? Tracer::instance().now() : 0;
+		const Page page = scan->decode(result);
+		if(Tracer::enabled())
+			Tracer::instance().complete("decode page", "json", decodeBegin, Tracer::instance().now(), scan->path);
+		if(page.rows == 0) {
+			// If we get an empty array, we are done.
+			scan->finally();
+			return;
+		}
+		if(page.lastId.isEmpty())
+			throw std::runtime_error("Page has no id to paginate on");
+		scan->lastId = page.lastId;
+
+		// Continue after the last id, with a page size scaled towards the targets
+		const double scale = std::min(double(targetPageMs) / elapsed, double(targetPageBytes) / std::max(result.size(), 1));
+		const double limit = scan->limit * std::min(std::max(scale, 0.5), 2.0);
+		scan->limit = std::min(std::max(int(limit), minimumPageSize), maximumPageSize);
+		getPage(scan);
+	}});
+}
+
+JexiaClient::Statistics& JexiaClient::Statistics::operator+=(const Statistics& other)
+{
+	requests += other.requests;
+	failures += other.failures;
+	bytesSent += other.bytesSent;
+	bytesReceived += other.bytesReceived;
+	latencyMs += other.latencyMs;
+	retries += other.retries;
+	timeouts += other.timeouts;
+	hedges += other.hedges;
+	hedgeWins += other.hedgeWins;
+	handshakes += other.handshakes;
+	handshakeMs += other.handshakeMs;
+	prewarmHandshakes += other.prewarmHandshakes;
+	refreshes += other.refreshes;
+	return *this;
+}
+
+void JexiaClient::printStatistics(const Statistics& statistics)
+{
+	std::cout << "Requests: " << statistics.requests
+		<< ", failures: " << statistics.failures
+		<< ", sent: " << statistics.bytesSent
+		<< " bytes, received: " << statistics.bytesReceived << " bytes";
+	if(statistics.requests > 0)
+		std::cout << ", mean latency: " << statistics.latencyMs / qint64(statistics.requests) << " ms";
+	std::cout << ", retries: " << statistics.retries
+		<< ", timeouts: " << statistics.timeouts
+		<< ", hedges: " << statistics.hedges << " (" << statistics.hedgeWins << " won)";
+	std::cout << ", token refreshes: " << statistics.refreshes;
+	// Requests that find a prewarmed connection do not handshake themselves
+	std::cout << ", TLS handshakes: " << statistics.handshakes << " (" << statistics.prewarmHandshakes << " prewarmed)";
+	if(statistics.handshakes > 0)
+		std::cout << " (" << statistics.handshakeMs / qint64(statistics.handshakes) << " ms each, " << statistics.handshakeMs << " ms total)";
+	std::cout << std::endl << std::flush;
+}
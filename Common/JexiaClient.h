@@ -0,0 +1,196 @@
+#pragma once
+#include <QtGlobal>
+#include <QObject>
+#include "CaptureNetworkAccessManager.h"
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QJsonObject>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+
+//
+// Thrown when a request to the Jexia project fails.
+//
+class JexiaError : public std::runtime_error
+{
+public:
+	JexiaError(const QString& operation, QNetworkReply* reply);
+
+	QNetworkReply::NetworkError networkError() const { return _networkError; }
+	int httpStatus() const { return _httpStatus; }
+	const QUrl& url() const { return _url; }
+	const QByteArray& body() const { return _body; }
+	// Why the request failed, in a few words: the reason it was aborted for,
+	// the HTTP status, or else the network error.
+	const QString& reason() const { return _reason; }
+
+private:
+	QNetworkReply::NetworkError _networkError;
+	int _httpStatus;
+	QString _reason;
+	QUrl _url;
+	QByteArray _body;
+};
+
+//
+// The HTTP client shared by the generators.
+//
+// The base URL and the request headers are encoded once, and every request
+// is copied from a prepared prototype. Paths are passed percent encoded.
+//
+class JexiaClient : public QObject
+{
+Q_OBJECT
+public:
+	JexiaClient(const QString& jexiaProjectUrl, const QString& jexiaKey, const QString& jexiaSecret);
+
+	struct Statistics {
+		quint64 requests = 0;
+		quint64 failures = 0;
+		quint64 bytesSent = 0;
+		quint64 bytesReceived = 0;
+		qint64 latencyMs = 0;
+		quint64 retries = 0;
+		quint64 timeouts = 0;
+		quint64 hedges = 0;
+		quint64 hedgeWins = 0;
+		quint64 handshakes = 0;
+		qint64 handshakeMs = 0;
+		quint64 prewarmHandshakes = 0;
+		quint64 refreshes = 0;
+
+		// Adds the statistics of another client, for totals over projects
+		Statistics& operator+=(const Statistics& other);
+	};
+
+	// How every request is bounded and retried. Only requests that are safe to
+	// send twice (GET, DELETE and authentication) are retried or hedged.
+	struct RequestPolicy {
+		int timeoutMs = 30000;
+		int maxAttempts = 4;
+		int backoffMs = 100;
+		int maxBackoffMs = 10000;
+		// Duplicate a page read that has not answered within the current p95
+		bool hedge = false;
+	};
+
+	void setRequestPolicy(const RequestPolicy& policy);
+
+	// Record every exchange to a capture file, or answer from one offline.
+	void record(const QString& path);
+	void replay(const QString& path, bool originalTimings);
+	void saveCapture() const;
+	// The seed a run has to use: the one of the capture when replaying,
+	// where a different given seed is refused, else seed, which is recorded.
+	quint64 captureSeed(quint64 seed, bool given);
+
+	// Open this many encrypted connections while authenticating.
+	void setPrewarmConnections(int connections);
+	// Keep the TLS session ticket in this file, so the next run can resume it.
+	void setTlsSessionFile(const QString& path);
+	void saveTlsSession() const;
+
+	void authenticate(std::function<void(void)> done);
+
+	void get(const QByteArray& path, std::function<void(QNetworkReply*)> replyParser);
+
+	// What a page decoder found: the number of rows and the id of the last one.
+	struct Page {
+		size_t rows;
+		QString lastId;
+	};
+
+	// Reads a whole dataset with keyset pagination, and hands every page to
+	// decode as raw bytes. finally is called after the last page.
+	void getRawArray(const QByteArray& path, std::function<Page(const QByteArray&)> decode, std::function<void(void)> finally);
+	void post(const QByteArray& path, const QByteArray& data, std::function<void(QNetworkReply*)> replyParser);
+	// Hands a failure to failed instead of throwing, for callers that can send less.
+	void post(const QByteArray& path, const QByteArray& data, std::function<void(QNetworkReply*)> replyParser, std::function<void(const JexiaError&)> failed);
+	void deleteResource(const QByteArray& path, std::function<void(QNetworkReply*)> replyParser);
+
+	// Streams the body, or the range [offset, offset + length) when length > 0,
+	// to onData as it arrives instead of keeping it in memory. The body of an
+	// error reply is not streamed, it ends up in the JexiaError passed to failed.
+	// So does a whole body sent in answer to a range.
+	void download(const QByteArray& path, qint64 offset, qint64 length, std::function<void(const QByteArray&)> onData, std::function<void(void)> finished, std::function<void(const JexiaError&)> failed);
+
+	const Statistics& statistics() const { return _statistics; }
+	void printStatistics() const { printStatistics(_statistics); }
+	static void printStatistics(const Statistics& statistics);
+
+private:
+	const QByteArray _baseUrl;
+	const QString _jexiaKey;
+	const QString _jexiaSecret;
+
+	QByteArray _accessToken;
+	QByteArray _refreshToken;
+	QTimer _refreshTimer;
+	std::vector<std::function<void(void)>> _waitingForToken;
+
+	QNetworkRequest _getRequest;
+	QNetworkRequest _postRequest;
+
+	CaptureNetworkAccessManager _nam;
+	Statistics _statistics;
+	RequestPolicy _policy;
+
+	// Connection setup, which later runs can skip with the saved ticket
+	int _prewarmConnections = 0;
+	QElapsedTimer _prewarmTimer;
+	QString _tlsSessionFile;
+	QByteArray _sessionTicket;
+	int _sessionLifetime = 0;
+
+	// Latencies of the last successful GETs, for the hedging threshold
+	std::vector<qint64> _latencies;
+	size_t _latencyIndex = 0;
+
+	// One logical request, over all of its attempts and hedges.
+	struct Call {
+		const char* operation;
+		bool idempotent;
+		bool hedged;
+		bool streaming;
+		std::function<QNetworkReply*(void)> send;
+		std::function<void(QNetworkReply*)> replyParser;
+		std::function<void(const JexiaError&)> failed;
+		// Sent again after a token refresh already, or authenticating itself
+		bool refreshed = false;
+		int attempts = 0;
+		bool done = false;
+		std::vector<QNetworkReply*> replies;
+	};
+
+	// The state of one keyset paginated getRawArray scan.
+	struct Scan {
+		QByteArray path;
+		std::function<Page(const QByteArray&)> decode;
+		std::function<void(void)> finally;
+		QString lastId;
+		int limit;
+	};
+
+	void getPage(std::shared_ptr<Scan> scan);
+
+	QNetworkRequest request(const QNetworkRequest& prototype, const QByteArray& path) const;
+	void setAccessToken(const QByteArray& accessToken);
+	void setTokens(QNetworkReply* reply);
+	void refresh(std::function<void(void)> then);
+	void prewarm();
+	void handshakeCompleted(QNetworkReply* reply, qint64 elapsed);
+	void keepSessionTicket(QNetworkReply* reply);
+	std::function<QNetworkReply*(void)> getter(const QByteArray& path);
+	void execute(Call call);
+	void startAttempt(std::shared_ptr<Call> call, bool hedge);
+	void finishAttempt(std::shared_ptr<Call> call, QNetworkReply* reply, qint64 elapsed);
+	void traceAttempt(const char* operation, QNetworkReply* reply);
+	bool isRetryable(QNetworkReply* reply) const;
+	int backoff(int attempt) const;
+	void recordLatency(qint64 latency);
+	qint64 latencyPercentile(double percentile) const;
+};
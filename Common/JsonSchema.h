@@ -0,0 +1,456 @@
+#pragma once
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+//
+// Compile time JSON schemas for entity structs.
+//
+// An entity is described once by specializing Schema:
+//
+//	template<> struct Schema<Generator::Partner> {
+//		static constexpr const char* name = "Partner";
+//		static constexpr const char* path = "/ds/partners";
+//		static constexpr auto fields = std::make_tuple(
+//			field("id", &Generator::Partner::uuid, Key),
+//			field("name", &Generator::Partner::name, Required));
+//	};
+//
+// decodeArray() then reads a page in one pass over the raw bytes: keys are
+// matched against the field list that the compiler unrolled, and values are
+// written straight into the members, without building a QJsonObject first.
+// encode() writes the fields that are not generated by the backend.
+//
+namespace JsonSchema {
+
+enum Flags : unsigned {
+	Optional = 0,
+	Required = 1,
+	// The id that is paginated on, always present
+	Key = 2 | Required,
+	// Assigned by the backend, so never encoded
+	Generated = 4,
+};
+
+template<typename T, typename M>
+struct Field {
+	std::string_view name;
+	M T::* member;
+	unsigned flags;
+};
+
+template<typename T, typename M>
+constexpr Field<T, M> field(std::string_view name, M T::* member, unsigned flags = Optional)
+{
+	return Field<T, M>{ name, member, flags };
+}
+
+template<typename T>
+struct Schema;
+
+class Decoder
+{
+public:
+	Decoder(const char* begin, const char* end, const char* entity)
+	: _p(begin), _end(end), _entity(entity)
+	{
+	}
+
+	void skipWhitespace()
+	{
+		while(_p < _end && (*_p == ' ' || *_p == '\n' || *_p == '\r' || *_p == '\t'))
+			_p++;
+	}
+
+	bool consume(char c)
+	{
+		skipWhitespace();
+		if(_p < _end && *_p == c) {
+			_p++;
+			return true;
+		}
+		return false;
+	}
+
+	void expect(char c)
+	{
+		if(!consume(c))
+			fail(std::string("expected '") + c + "'");
+	}
+
+	// The raw bytes of a string without escapes, or of its escaped form.
+	std::string_view rawString(bool& escaped)
+	{
+		expect('"');
+		const char* begin = _p;
+		escaped = false;
+		while(_p < _end && *_p != '"') {
+			if(*_p == '\\') {
+				escaped = true;
+				_p++;
+			}
+			_p++;
+		}
+		if(_p >= _end)
+			fail("unterminated string");
+		return std::string_view(begin, size_t(_p++ - begin));
+	}
+
+	void read(QString& value)
+	{
+		if(literal("null")) {
+			value = QString();
+			return;
+		}
+		bool escaped;
+		const std::string_view raw = rawString(escaped);
+		if(!escaped) {
+			value = QString::fromUtf8(raw.data(), int(raw.size()));
+			return;
+		}
+		const std::string unescaped = unescape(raw);
+		value = QString::fromUtf8(unescaped.data(), int(unescaped.size()));
+	}
+
+	template<typename I>
+	typename std::enable_if<std::is_integral<I>::value && !std::is_same<I, bool>::value>::type read(I& value)
+	{
+		skipWhitespace();
+		if(literal("null")) {
+			value = 0;
+			return;
+		}
+		const auto result = std::from_chars(_p, _end, value);
+		if(result.ec != std::errc())
+			fail("expected an integer");
+		// Like QJsonValue::toInt, a number with a fraction or an exponent is truncated
+		if(result.ptr < _end && (*result.ptr == '.' || *result.ptr == 'e' || *result.ptr == 'E')) {
+			double d;
+			readNumber(d);
+			value = I(d);
+			return;
+		}
+		_p = result.ptr;
+	}
+
+	void read(double& value)
+	{
+		skipWhitespace();
+		if(literal("null")) {
+			value = 0;
+			return;
+		}
+		readNumber(value);
+	}
+
+	void read(bool& value)
+	{
+		if(literal("true"))
+			value = true;
+		else if(literal("false") || literal("null"))
+			value = false;
+		else
+			fail("expected a boolean");
+	}
+
+	// Skips any value, nested objects and arrays included.
+	void skipValue()
+	{
+		skipWhitespace();
+		if(_p >= _end)
+			fail("expected a value");
+		if(*_p == '"') {
+			bool escaped;
+			rawString(escaped);
+			return;
+		}
+		if(*_p != '{' && *_p != '[') {
+			while(_p < _end && *_p != ',' && *_p != '}' && *_p != ']')
+				_p++;
+			return;
+		}
+		int depth = 0;
+		while(_p < _end) {
+			const char c = *_p;
+			if(c == '"') {
+				bool escaped;
+				rawString(escaped);
+				continue;
+			}
+			_p++;
+			if(c == '{' || c == '[') {
+				depth++;
+			} else if(c == '}' || c == ']') {
+				if(--depth == 0)
+					return;
+			}
+		}
+		fail("unterminated value");
+	}
+
+	bool atEnd()
+	{
+		skipWhitespace();
+		return _p >= _end;
+	}
+
+	[[noreturn]] void fail(const std::string& reason) const
+	{
+		throw std::runtime_error(std::string(_entity) + " JSON is invalid: " + reason);
+	}
+
+private:
+	const char* _p;
+	const char* const _end;
+	const char* const _entity;
+
+	bool literal(std::string_view word)
+	{
+		skipWhitespace();
+		if(size_t(_end - _p) >= word.size() && memcmp(_p, word.data(), word.size()) == 0) {
+			_p += word.size();
+			return true;
+		}
+		return false;
+	}
+
+	void readNumber(double& value)
+	{
+		// Not strtod, which follows the locale that QCoreApplication sets,
+		// so 3.7 would stop at the '.' under a comma decimal locale.
+		const char* end = _p;
+		while(end < _end && ((*end >= '0' && *end <= '9') || *end == '-' || *end == '+' || *end == '.' || *end == 'e' || *end == 'E'))
+			end++;
+		bool ok = false;
+		value = QByteArray::fromRawData(_p, int(end - _p)).toDouble(&ok);
+		if(!ok)
+			fail("expected a number");
+		_p = end;
+	}
+
+	static void appendUtf8(std::string& out, quint32 c)
+	{
+		if(c < 0x80) {
+			out += char(c);
+		} else if(c < 0x800) {
+			out += char(0xc0 | (c >> 6));
+			out += char(0x80 | (c & 0x3f));
+		} else if(c < 0x10000) {
+			out += char(0xe0 | (c >> 12));
+			out += char(0x80 | ((c >> 6) & 0x3f));
+			out += char(0x80 | (c & 0x3f));
+		} else {
+			out += char(0xf0 | (c >> 18));
+			out += char(0x80 | ((c >> 12) & 0x3f));
+			out += char(0x80 | ((c >> 6) & 0x3f));
+			out += char(0x80 | (c & 0x3f));
+		}
+	}
+
+	quint32 hex4(std::string_view raw, size_t i) const
+	{
+		if(i + 4 > raw.size())
+			fail("truncated \\u escape");
+		quint32 result = 0;
+		const auto r = std::from_chars(raw.data() + i, raw.data() + i + 4, result, 16);
+		if(r.ec != std::errc() || r.ptr != raw.data() + i + 4)
+			fail("invalid \\u escape");
+		return result;
+	}
+
+	std::string unescape(std::string_view raw) const
+	{
+		std::string out;
+		out.reserve(raw.size());
+		for(size_t i = 0; i < raw.size(); i++) {
+			if(raw[i] != '\\') {
+				out += raw[i];
+				continue;
+			}
+			if(++i >= raw.size())
+				fail("truncated escape");
+			switch(raw[i]) {
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u': {
+				quint32 c = hex4(raw, i + 1);
+				i += 4;
+				if(c >= 0xd800 && c < 0xdc00 && i + 2 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u') {
+					const quint32 low = hex4(raw, i + 3);
+					if(low >= 0xdc00 && low < 0xe000) {
+						c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+						i += 6;
+					}
+				}
+				appendUtf8(out, c);
+				break;
+			}
+			default:
+				fail("invalid escape");
+			}
+		}
+		return out;
+	}
+};
+
+// Reads the members of one object into entity.
+template<typename T>
+void decodeObject(Decoder& decoder, T& entity)
+{
+	constexpr size_t count = std::tuple_size<std::decay_t<decltype(Schema<T>::fields)>>::value;
+	static_assert(count <= 32, "Schemas are limited to 32 fields");
+	quint32 seen = 0;
+
+	decoder.expect('{');
+	if(!decoder.consume('}')) {
+		do {
+			bool escaped;
+			const std::string_view key = decoder.rawString(escaped);
+			decoder.expect(':');
+			bool matched = false;
+			quint32 bit = 1;
+			std::apply([&] (const auto&... field) {
+				// Unrolled at compile time, stops at the first field that matches
+				((matched || (!escaped && key == field.name
+					? (decoder.read(entity.*(field.member)), seen |= bit, matched = true)
+					: (bit <<= 1, false))), ...);
+			}, Schema<T>::fields);
+			if(!matched)
+				decoder.skipValue();
+		} while(decoder.consume(','));
+		decoder.expect('}');
+	}
+
+	quint32 bit = 1;
+	std::apply([&] (const auto&... field) {
+		((((field.flags & Required) && !(seen & bit)) ? decoder.fail("missing " + std::string(field.name)) : void(), bit <<= 1), ...);
+	}, Schema<T>::fields);
+}
+
+// Appends every object of a JSON array to entities, returns how many there were.
+template<typename T>
+size_t decodeArray(const QByteArray& bytes, std::vector<T>& entities)
+{
+	Decoder decoder(bytes.constData(), bytes.constData() + bytes.size(), Schema<T>::name);
+	size_t count = 0;
+	decoder.expect('[');
+	if(!decoder.consume(']')) {
+		do {
+			entities.emplace_back();
+			decodeObject(decoder, entities.back());
+			count++;
+		} while(decoder.consume(','));
+		decoder.expect(']');
+	}
+	if(!decoder.atEnd())
+		decoder.fail("trailing data after the array");
+	return count;
+}
+
+template<typename T, typename M>
+void readKey(const T& entity, const Field<T, M>& field, QString& result)
+{
+	if constexpr(std::is_same<M, QString>::value) {
+		if((field.flags & Key) == Key)
+			result = entity.*(field.member);
+	}
+}
+
+// The value of the Key field, which getRawArray paginates on.
+template<typename T>
+QString key(const T& entity)
+{
+	QString result;
+	std::apply([&] (const auto&... field) {
+		(readKey(entity, field, result), ...);
+	}, Schema<T>::fields);
+	return result;
+}
+
+inline void write(QByteArray& out, const QString& value)
+{
+	static const char hex[] = "0123456789abcdef";
+	const QByteArray utf8 = value.toUtf8();
+	out.append('"');
+	for(const char c: utf8) {
+		if(c == '"' || c == '\\') {
+			out.append('\\');
+			out.append(c);
+		} else if(quint8(c) < 0x20) {
+			out.append("\\u00");
+			out.append(hex[c >> 4]);
+			out.append(hex[c & 0xf]);
+		} else {
+			out.append(c);
+		}
+	}
+	out.append('"');
+}
+
+template<typename I>
+typename std::enable_if<std::is_integral<I>::value && !std::is_same<I, bool>::value>::type write(QByteArray& out, I value)
+{
+	out.append(QByteArray::number(value));
+}
+
+inline void write(QByteArray& out, double value)
+{
+	out.append(QByteArray::number(value, 'g', 17));
+}
+
+inline void write(QByteArray& out, bool value)
+{
+	out.append(value ? "true" : "false");
+}
+
+// Appends the object, without the fields the backend generates.
+template<typename T>
+void encode(const T& entity, QByteArray& out)
+{
+	bool first = true;
+	out.append('{');
+	std::apply([&] (const auto&... field) {
+		(((field.flags & Generated) ? void() : (out.append(first ? "\"" : ",\""),
+			out.append(field.name.data(), int(field.name.size())),
+			out.append("\":"),
+			write(out, entity.*(field.member)),
+			first = false, void())), ...);
+	}, Schema<T>::fields);
+	out.append('}');
+}
+
+// Encodes [begin, end), so a batch can be cut from a larger vector.
+template<typename Iterator>
+QByteArray encodeArray(Iterator begin, Iterator end)
+{
+	QByteArray out;
+	out.append('[');
+	for(Iterator i = begin; i != end; ++i) {
+		if(i != begin)
+			out.append(',');
+		encode(*i, out);
+	}
+	out.append(']');
+	return out;
+}
+
+template<typename T>
+QByteArray encodeArray(const std::vector<T>& entities)
+{
+	return encodeArray(entities.begin(), entities.end());
+}
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <QtGlobal>
+#include <QString>
+#include <cstring>
+
+//
+// A xoshiro256** generator that can be split into independent streams.
+//
+// jump() advances the state by 2^128 draws and longJump() by 2^192 draws, so
+// streams derived from the same seed never overlap in practice. Work is split
+// by giving every unit (a file, a chunk, a batch) its own derived stream, which
+// makes the output depend only on the seed and never on the thread count.
+// Units are numbered by keeping a running stream and jumping it once per unit,
+// a jump costs 256 draws.
+//
+class RandomStream
+{
+public:
+	explicit RandomStream(quint64 seed = 0)
+	{
+		// Expand the seed with splitmix64, as recommended by the xoshiro authors.
+		for(quint64& s: _state) {
+			seed += 0x9e3779b97f4a7c15ULL;
+			quint64 z = seed;
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			s = z ^ (z >> 31);
+		}
+	}
+
+	quint64 generate64()
+	{
+		const quint64 result = rotl(_state[1] * 5, 7) * 9;
+		const quint64 t = _state[1] << 17;
+		_state[2] ^= _state[0];
+		_state[3] ^= _state[1];
+		_state[1] ^= _state[2];
+		_state[0] ^= _state[3];
+		_state[2] ^= t;
+		_state[3] = rotl(_state[3], 45);
+		return result;
+	}
+
+	// Returns a value in [lowest, highest), like QRandomGenerator::bounded.
+	quint32 bounded(quint32 lowest, quint32 highest)
+	{
+		const quint64 range = highest - lowest;
+		return lowest + quint32(((generate64() >> 32) * range) >> 32);
+	}
+
+	void fill(char* data, size_t size)
+	{
+		size_t p = 0;
+		quint64 temp;
+		while((p + 8) <= size) {
+			temp = generate64();
+			memcpy(data + p, &temp, 8);
+			p += 8;
+		}
+		if(p < size) {
+			temp = generate64();
+			memcpy(data + p, &temp, size - p);
+		}
+	}
+
+	QString base36(size_t length)
+	{
+		static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+		QString result;
+		result.reserve(int(length));
+		for(size_t i=0; i < length; i++)
+			result.append(QLatin1Char(digits[bounded(0, 35)]));
+		return result;
+	}
+
+	void jump()
+	{
+		static const quint64 polynomial[] = {
+			0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+		};
+		advance(polynomial);
+	}
+
+	void longJump()
+	{
+		static const quint64 polynomial[] = {
+			0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL
+		};
+		advance(polynomial);
+	}
+
+private:
+	quint64 _state[4];
+
+	static quint64 rotl(quint64 x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+	void advance(const quint64 (&polynomial)[4])
+	{
+		quint64 s[4] = { 0, 0, 0, 0 };
+		for(quint64 word: polynomial) {
+			for(int b=0; b < 64; b++) {
+				if(word & (quint64(1) << b)) {
+					for(int i=0; i < 4; i++)
+						s[i] ^= _state[i];
+				}
+				generate64();
+			}
+		}
+		memcpy(_state, s, sizeof(_state));
+	}
+};
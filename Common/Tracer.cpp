@@ -0,0 +1,80 @@
+#include "Tracer.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <stdexcept>
+#include <iostream>
+
+bool Tracer::_enabled = false;
+
+Tracer& Tracer::instance()
+{
+	static Tracer tracer;
+	return tracer;
+}
+
+void Tracer::start(const QString& path)
+{
+	_path = path;
+	_events.reserve(65536);
+	_clock.start();
+	_enabled = true;
+}
+
+int Tracer::track(const char* name)
+{
+	_tracks.push_back(name);
+	return mainTrack + int(_tracks.size());
+}
+
+void Tracer::complete(const char* name, const char* category, qint64 begin, qint64 end, const QByteArray& detail, int track)
+{
+	_events.push_back(Event{ name, category, track, 0, begin, end, detail, false });
+}
+
+void Tracer::async(const char* name, const char* category, quint64 id, qint64 begin, qint64 end, const QByteArray& detail)
+{
+	_events.push_back(Event{ name, category, mainTrack, id, begin, end, detail, true });
+}
+
+// {"traceEvents":[{"name":"GET","cat":"http","ph":"X","ts":12.5,"dur":3.1,"pid":1,"tid":1,"args":{"detail":"..."}}]}
+void Tracer::write() const
+{
+	if(!_enabled)
+		return;
+	QFile file(_path);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		throw std::runtime_error("Could not open trace file " + _path.toStdString());
+
+	const auto microseconds = [] (qint64 ns) { return QByteArray::number(ns / 1000.0, 'f', 3); };
+	const auto common = [] (const Event& e) {
+		return "{\"name\":\"" + QByteArray(e.name) + "\",\"cat\":\"" + QByteArray(e.category) + "\",\"pid\":1,\"tid\":" + QByteArray::number(e.track);
+	};
+	const auto args = [] (const Event& e) {
+		if(e.detail.isEmpty())
+			return QByteArray();
+		// Let QJsonDocument do the escaping
+		const QByteArray object = QJsonDocument(QJsonObject {{"detail", QString::fromUtf8(e.detail)}}).toJson(QJsonDocument::Compact);
+		return ",\"args\":" + object;
+	};
+
+	file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	// Thread names label the tracks
+	file.write("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(mainTrack) + ",\"args\":{\"name\":\"main\"}}");
+	for(size_t i = 0; i < _tracks.size(); i++)
+		file.write(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(mainTrack + int(i) + 1)
+			+ ",\"args\":{\"name\":\"" + QByteArray(_tracks[i]) + " " + QByteArray::number(int(i) + 1) + "\"}}");
+	for(const Event& e: _events) {
+		QByteArray line = ",\n";
+		if(e.async) {
+			const QByteArray id = ",\"id\":" + QByteArray::number(e.id);
+			line += common(e) + ",\"ph\":\"b\",\"ts\":" + microseconds(e.begin) + id + args(e) + "},\n";
+			line += common(e) + ",\"ph\":\"e\",\"ts\":" + microseconds(e.end) + id + "}";
+		} else {
+			line += common(e) + ",\"ph\":\"X\",\"ts\":" + microseconds(e.begin) + ",\"dur\":" + microseconds(e.end - e.begin) + args(e) + "}";
+		}
+		file.write(line);
+	}
+	file.write("\n]}\n");
+	std::cout << "Wrote " << _events.size() << " trace events to " << _path.toStdString() << std::endl << std::flush;
+}
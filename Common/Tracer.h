@@ -0,0 +1,59 @@
+#pragma once
+#include <QtGlobal>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <vector>
+
+//
+// Records spans in memory and writes them as Chrome trace event JSON,
+// which chrome://tracing and Perfetto open.
+//
+// Tracing is off unless start() is called. A span then costs a clock read
+// and a vector append, and names are static strings, so it can stay on
+// during load tests. Only the thread that runs the event loop records spans.
+//
+class Tracer
+{
+public:
+	static Tracer& instance();
+	static bool enabled() { return _enabled; }
+
+	void start(const QString& path);
+	void write() const;
+
+	// Nanoseconds since start()
+	qint64 now() const { return _clock.nsecsElapsed(); }
+	quint64 nextId() { return ++_lastId; }
+
+	// A track of its own for spans that do not nest with those of the main
+	// thread, shown as a separate thread.
+	int track(const char* name);
+
+	// A span on a track, the main thread by default. Spans on one track must
+	// nest by time.
+	void complete(const char* name, const char* category, qint64 begin, qint64 end, const QByteArray& detail = QByteArray(), int track = mainTrack);
+	// A span that overlaps others, grouped by id
+	void async(const char* name, const char* category, quint64 id, qint64 begin, qint64 end, const QByteArray& detail = QByteArray());
+
+	static const int mainTrack = 1;
+
+private:
+	struct Event {
+		const char* name;
+		const char* category;
+		int track;
+		quint64 id;
+		qint64 begin;
+		qint64 end;
+		QByteArray detail;
+		bool async;
+	};
+
+	static bool _enabled;
+	QString _path;
+	QElapsedTimer _clock;
+	quint64 _lastId = 0;
+	std::vector<Event> _events;
+	std::vector<const char*> _tracks;
+};
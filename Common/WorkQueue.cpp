@@ -0,0 +1,32 @@
+#include "WorkQueue.h"
+#include "Tracer.h"
+
+void WorkQueue::add(const char* name, std::function<void(void)> job)
+{
+	_jobs.push_back(Job{ name, job, Tracer::enabled() ? Tracer::instance().now() : 0 });
+}
+
+bool WorkQueue::next()
+{
+	const bool trace = Tracer::enabled();
+	const qint64 now = trace ? Tracer::instance().now() : 0;
+	if(trace && _running)
+		Tracer::instance().complete(_running, "job", _started, now, QByteArray(), _track);
+	_running = nullptr;
+
+	if(_jobs.empty())
+		return false;
+
+	const Job job = _jobs.front();
+	_jobs.pop_front();
+	if(trace) {
+		Tracer& tracer = Tracer::instance();
+		if(_track == 0)
+			_track = tracer.track("jobs");
+		tracer.async("queued", "job", tracer.nextId(), job.enqueued, now, job.name);
+		_running = job.name;
+		_started = now;
+	}
+	job.run();
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <QtGlobal>
+#include <deque>
+#include <functional>
+
+//
+// The jobs of a generator, run one after the other. A job is asynchronous:
+// it ends when it asks for the next one, usually from a reply handler.
+// With tracing on, the time a job waited in the queue and the time it ran
+// are recorded as spans. Jobs end inside reply handlers, so their spans go
+// on a track of each queue's own, where they nest.
+//
+class WorkQueue
+{
+public:
+	void add(const char* name, std::function<void(void)> job);
+	bool empty() const { return _jobs.empty(); }
+
+	// Ends the running job and starts the next one, false when there is none.
+	bool next();
+
+private:
+	struct Job {
+		const char* name;
+		std::function<void(void)> run;
+		qint64 enqueued;
+	};
+
+	std::deque<Job> _jobs;
+	const char* _running = nullptr;
+	qint64 _started = 0;
+	int _track = 0;
+};
@@ -0,0 +1,132 @@
+#include "XxHash64.h"
+#include <cstring>
+#include <algorithm>
+
+static const quint64 prime1 = 0x9e3779b185ebca87ULL;
+static const quint64 prime2 = 0xc2b2ae3d27d4eb4fULL;
+static const quint64 prime3 = 0x165667b19e3779f9ULL;
+static const quint64 prime4 = 0x85ebca77c2b2ae63ULL;
+static const quint64 prime5 = 0x27d4eb2f165667c5ULL;
+
+static inline quint64 rotl(quint64 x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline quint64 read64(const unsigned char* p)
+{
+	quint64 result;
+	memcpy(&result, p, 8);
+	return result;
+}
+
+static inline quint32 read32(const unsigned char* p)
+{
+	quint32 result;
+	memcpy(&result, p, 4);
+	return result;
+}
+
+static inline quint64 round(quint64 accumulator, quint64 input)
+{
+	accumulator += input * prime2;
+	return rotl(accumulator, 31) * prime1;
+}
+
+static inline quint64 merge(quint64 hash, quint64 accumulator)
+{
+	hash ^= round(0, accumulator);
+	return hash * prime1 + prime4;
+}
+
+XxHash64::XxHash64(quint64 seed)
+{
+	reset(seed);
+}
+
+void XxHash64::reset(quint64 seed)
+{
+	_seed = seed;
+	_accumulators[0] = seed + prime1 + prime2;
+	_accumulators[1] = seed + prime2;
+	_accumulators[2] = seed;
+	_accumulators[3] = seed - prime1;
+	_length = 0;
+	_buffered = 0;
+}
+
+void XxHash64::update(const char* data, size_t size)
+{
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+	const unsigned char* const end = p + size;
+	_length += size;
+
+	// Complete a stripe that was left over from the last update
+	if(_buffered > 0) {
+		const size_t fill = std::min(size, sizeof(_buffer) - _buffered);
+		memcpy(_buffer + _buffered, p, fill);
+		_buffered += fill;
+		p += fill;
+		if(_buffered < sizeof(_buffer))
+			return;
+		for(int i=0; i < 4; i++)
+			_accumulators[i] = round(_accumulators[i], read64(_buffer + 8 * i));
+		_buffered = 0;
+	}
+
+	while(p + 32 <= end) {
+		for(int i=0; i < 4; i++)
+			_accumulators[i] = round(_accumulators[i], read64(p + 8 * i));
+		p += 32;
+	}
+
+	if(p < end) {
+		_buffered = size_t(end - p);
+		memcpy(_buffer, p, _buffered);
+	}
+}
+
+quint64 XxHash64::digest() const
+{
+	quint64 hash;
+	if(_length >= 32) {
+		hash = rotl(_accumulators[0], 1) + rotl(_accumulators[1], 7) + rotl(_accumulators[2], 12) + rotl(_accumulators[3], 18);
+		for(int i=0; i < 4; i++)
+			hash = merge(hash, _accumulators[i]);
+	} else {
+		hash = _seed + prime5;
+	}
+	hash += _length;
+
+	const unsigned char* p = _buffer;
+	const unsigned char* const end = _buffer + _buffered;
+	while(p + 8 <= end) {
+		hash ^= round(0, read64(p));
+		hash = rotl(hash, 27) * prime1 + prime4;
+		p += 8;
+	}
+	if(p + 4 <= end) {
+		hash ^= quint64(read32(p)) * prime1;
+		hash = rotl(hash, 23) * prime2 + prime3;
+		p += 4;
+	}
+	while(p < end) {
+		hash ^= (*p) * prime5;
+		hash = rotl(hash, 11) * prime1;
+		p++;
+	}
+
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+quint64 XxHash64::hash(const char* data, size_t size, quint64 seed)
+{
+	XxHash64 h(seed);
+	h.update(data, size);
+	return h.digest();
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <QtGlobal>
+#include <cstddef>
+
+//
+// Streaming XXH64, so large bodies can be checked without buffering them.
+//
+class XxHash64
+{
+public:
+	explicit XxHash64(quint64 seed = 0);
+
+	void reset(quint64 seed = 0);
+	void update(const char* data, size_t size);
+	quint64 digest() const;
+
+	static quint64 hash(const char* data, size_t size, quint64 seed = 0);
+
+private:
+	quint64 _accumulators[4];
+	quint64 _seed;
+	quint64 _length;
+	unsigned char _buffer[32];
+	size_t _buffered;
+};
@@ -0,0 +1,12 @@
+NAME            = GreenBitesCommon
+TEMPLATE        = lib
+TARGET          = greenbites
+
+QT += network
+
+HEADERS = BatchTuner.h CaptureNetworkAccessManager.h ClientOptions.h JexiaClient.h JsonSchema.h RandomStream.h Tracer.h WorkQueue.h XxHash64.h
+SOURCES = BatchTuner.cpp CaptureNetworkAccessManager.cpp ClientOptions.cpp JexiaClient.cpp Tracer.cpp WorkQueue.cpp XxHash64.cpp
+
+CONFIG += staticlib c++17
+
+QMAKE_CXXFLAGS += -O3
@@ -1,34 +1,28 @@
 #include "Generator.h"
+#include "Schemas.h"
 #include <QTimer>
+#include <QEventLoop>
+#include <QElapsedTimer>
 #include <iostream>
 #include <QNetworkReply>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QAuthenticator>
-#include <QJsonArray>
-#include <QThread>
-#include <QScopedPointer>
+#include <QRandomGenerator>
 
 Generator::Generator(const QString& jexiaProjectUrl, const QString& jexiaKey, const QString& jexiaSecret)
-: _jexiaProjectUrl(jexiaProjectUrl)
-, _jexiaKey(jexiaKey)
-, _jexiaSecret(jexiaSecret)
-, _randomGenerator(QRandomGenerator::securelySeeded())
+: _client(jexiaProjectUrl, jexiaKey, jexiaSecret)
+, _seed(QRandomGenerator::securelySeeded().generate64())
+, _productStream(_seed)
 {
-//	void QNetworkAccessManager::authenticationRequired(QNetworkReply *reply, QAuthenticator *authenticator)
-
-	QObject::connect(&_nam, &QNetworkAccessManager::authenticationRequired, [] {
-		std::cout << "QNetworkAccessManager::authenticationRequired - 100" << std::endl << std::flush;
-	});
+	_workQueue.add("authenticate", [&] { authenticate(); });
+	_workQueue.add("getPartners", [&] { getPartners(); });
+//	_workQueue.add("getProducts", [&] { getProducts(); });
+	_workQueue.add("getPackageTypes", [&] { getPackageTypes(); });
+	_workQueue.add("getPackages", [&] { getPackages(); });
+	_workQueue.add("getShipments", [&] { getShipments(); });
+}
 
-	_workQueue = {
-		[&] { authenticate(); },
-		[&] { getPartners(); },
-//		[&] { getProducts(); },
-		[&] { getPackageTypes(); },
-		[&] { getPackages(); },
-		[&] { getShipments(); }
-	};
+void Generator::setName(const QString& name)
+{
+	_name = name;
 }
 
 void Generator::setRepetitions(size_t count)
@@ -36,182 +30,155 @@ void Generator::setRepetitions(size_t count)
 	_repetitions = count;
 }
 
+void Generator::setSeed(quint64 seed)
+{
+	_seed = seed;
+	_seedGiven = true;
+	_productStream = RandomStream(seed);
+}
+
+void Generator::setBatchSize(size_t rows)
+{
+	_batchSize = rows;
+}
+
+void Generator::setAutoBatch(bool enabled)
+{
+	_autoBatch = enabled;
+}
+
 void Generator::getProducts()
 {
-	_workQueue.emplace_back([&] { getProductsJob(); });
+	_workQueue.add("getProducts", [&] { getProductsJob(); });
 }
 
 void Generator::getProductsCount()
 {
-	_workQueue.emplace_back([&] { getProductsCountJob(); });
+	_workQueue.add("getProductsCount", [&] { getProductsCountJob(); });
 }
 
 void Generator::createPartners(size_t count)
 {
-	_workQueue.emplace_back([&] { createPartnersJob(count); });
+	_workQueue.add("createPartners", [&, count] { createPartnersJob(count); });
 }
 
 void Generator::createProducts(size_t count)
 {
 	for(size_t i = 0; i < _repetitions; i++)
-		_workQueue.emplace_back([&, count] { createProductsJob(count); });
+		_workQueue.add("createProducts", [&, count] { createProductsJob(count); });
 }
 
 void Generator::deleteAllProducts()
 {
 	// These must be enqueued as separate tasks
 	// because the lambda finishes before the responses are parsed.
-	_workQueue.emplace_back([&] { deleteAllProductsJob(); });
+	_workQueue.add("deleteAllProducts", [&] { deleteAllProductsJob(); });
 }
 
-void Generator::run()
+static void printThroughput(const JexiaClient::Statistics& statistics, size_t rows, qint64 elapsedMs)
 {
-	QTimer::singleShot(10, [&] { process(); });
-	_loop.exec();
+	const double seconds = double(std::max<qint64>(elapsedMs, 1)) / 1000;
+	std::cout << "Throughput: " << qint64(double(statistics.requests) / seconds) << " requests/s, "
+		<< qint64(double(rows) / seconds) << " rows created/s, "
+		<< qint64(double(statistics.bytesSent + statistics.bytesReceived) / 1024 / seconds) << " KiB/s over "
+		<< elapsedMs << " ms" << std::endl << std::flush;
 }
 
-void Generator::process()
+void Generator::run(const std::vector<Generator*>& generators)
 {
-	if(_workQueue.empty()) {
-		_loop.quit();
-		return;
+	QEventLoop loop;
+	QElapsedTimer clock;
+	clock.start();
+	size_t running = generators.size();
+	for(Generator* generator: generators)
+		generator->start([&] {
+			if(--running == 0)
+				loop.quit();
+		});
+	loop.exec();
+	const qint64 elapsedMs = clock.elapsed();
+
+	JexiaClient::Statistics total;
+	size_t rows = 0;
+	for(const Generator* generator: generators) {
+		generator->finish();
+		total += generator->_client.statistics();
+		rows += generator->_rowsCreated;
+	}
+	if(generators.size() > 1) {
+		std::cout << "All " << generators.size() << " projects\n";
+		JexiaClient::printStatistics(total);
+		printThroughput(total, rows, elapsedMs);
 	}
-	
-	auto f = _workQueue.front();
-	_workQueue.pop_front();
-	f();
 }
 
-void Generator::authenticate()
+void Generator::start(std::function<void(void)> finished)
 {
-	// Send an authentication request.
-	QJsonObject object {
-		{"method", "apk"},
-		{"key", _jexiaKey},
-		{"secret", _jexiaSecret},
-	};
-	
-	QNetworkRequest request(_jexiaProjectUrl + "/auth");
-	request.setHeader(QNetworkRequest::ContentTypeHeader,QVariant("application/x-www-form-urlencoded"));
-	QNetworkReply* reply = _nam.post(request, QJsonDocument(object).toJson());
-	QObject::connect(reply, &QNetworkReply::finished, [this, reply] () { 
-		QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> r(reply);
-		auto doc = QJsonDocument::fromJson(reply->readAll());
-		if(!doc.isObject())
-			throw std::runtime_error("Authentication reply is not a JSON object");
-		const auto object = doc.object();
-		if(!object.contains("access_token"))
-			throw std::runtime_error("Authentication JSON object must contain access_token");
-		if(!object.contains("refresh_token"))
-			throw std::runtime_error("Authentication JSON object must contain refresh_token");
-		_accessToken = object.value("access_token").toString();
-		_refreshToken = object.value("refresh_token").toString();
-		if(_accessToken.isEmpty() || _refreshToken.isEmpty())
-			throw std::runtime_error("One of the tokens is empty");
-		
-		// The next step
-		process();
-	});
+	const quint64 seed = _client.captureSeed(_seed, _seedGiven);
+	if(seed != _seed)
+		setSeed(seed);
+	std::cout << (_name.isEmpty() ? "" : _name.toStdString() + " ") << "Seed " << _seed << std::endl << std::flush;
+	_finished = finished;
+	_clock.start();
+	QTimer::singleShot(10, this, [this] { process(); });
 }
 
-void Generator::get(const QString& path, std::function<void(QNetworkReply*)> replyParser)
+void Generator::process()
 {
-//	QThread::msleep(200);
-	
-	QNetworkRequest request(_jexiaProjectUrl + path);
-	request.setRawHeader("Authorization", "Bearer " + _accessToken.toUtf8());
-	
-	QNetworkReply* reply = _nam.get(request);
-	QObject::connect(reply, &QNetworkReply::finished, [replyParser, reply] {
-		QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> r(reply);
-		if(!reply->isFinished())
-			throw std::runtime_error("HTTP Reply is not finished");
-		if(reply->isRunning())
-			throw std::runtime_error("HTTP Reply is still running");
-		if(reply->error() != QNetworkReply::NoError) {
-			std::cout << "HTTP GET Request failed: \n" << std::endl;
-			std::cout << "Url: " << reply->request().url().toString().toStdString() << "\n";
-			std::cout << QString::fromUtf8(reply->readAll()).toStdString() << std::endl << std::flush;
-			const QString errorString = reply->errorString();
-			const auto s = "HTTP GET Request failed (" + QString::number(reply->error()) + "): " + errorString;
-			std::cout << "Status code: " << reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() <<"\n";
-			throw std::runtime_error(s.toStdString());
-		}
-		replyParser(reply);
-	});
+	if(!_workQueue.next()) {
+		_elapsedMs = _clock.elapsed();
+		_finished();
+	}
 }
 
-// range={"limit": 5, "offset": 3}
-void Generator::getArray(const QString& path, std::function<void(QJsonObject)> apply, std::function<void(void)> finally, size_t offset)
+void Generator::finish() const
 {
-	std::cout << "getArray (" << path.toStdString() << ", " << offset << ")" << std::endl << std::flush;
-	
-	QString paginatePath;
-	if(offset == 0) {
-		paginatePath = path;
-	} else {
-		const QString r = "{\"limit\": 1000, \"offset\": " + QString::number(offset) + "}";
-		paginatePath = path + "?range=" + QUrl::toPercentEncoding(r);
-	}
-	
-	get(paginatePath, [&, path, apply, finally, offset] (QNetworkReply* reply) {
-		const QByteArray result = reply->readAll();
-		const auto doc = QJsonDocument::fromJson(result);
-		if(!doc.isArray())
-			throw std::runtime_error("Document is not a json array");
-		const auto array = doc.array();
-		if(!array.isEmpty()) {
-			for(const QJsonValue& element: array) {
-				if(!element.isObject())
-					throw std::runtime_error("Element is not an object");
-				apply(element.toObject());
-			}
-			// Continue with next offset
-			getArray(path, apply, finally, offset + array.size());
-		} else {
-			// If we get an empty array, we are done.
-			finally();
-		}
-	});
+	_client.saveCapture();
+	_client.saveTlsSession();
+	if(!_name.isEmpty())
+		std::cout << "Project " << _name.toStdString() << "\n";
+	_client.printStatistics();
+	printThroughput(_client.statistics(), _rowsCreated, _elapsedMs);
+	for(const auto& tuner: _batchTuners)
+		tuner.second.print(tuner.first.c_str());
 }
 
-void Generator::getPartners()
+void Generator::authenticate()
 {
-	getArray("/ds/partners", [&] (QJsonObject object) { 
-		if(!object.contains("id") || !object.contains("name"))
-			throw std::runtime_error("Partner JSON object is invalid");
-		const QString uuid = object.value("id").toString();
-		const QString name = object.value("name").toString();
-		_partners.emplace_back(Partner{ uuid, name });
+	_client.authenticate([&] { process(); });
+}
+
+// Reads a whole dataset, decoding the pages straight into the entities.
+template<typename T>
+void Generator::getEntities(std::vector<T>& entities)
+{
+	using Schema = JsonSchema::Schema<T>;
+	_client.getRawArray(Schema::path, [&entities] (const QByteArray& result) {
+		const size_t rows = JsonSchema::decodeArray(result, entities);
+		return JexiaClient::Page { rows, rows > 0 ? JsonSchema::key(entities.back()) : QString() };
 	}, [&] {
-		std::cout << "========= Parsed partners ========= " << _partners.size() << std::endl << std::flush;
-		for(auto& p: _partners)
-			p.print();
+		std::cout << "========= Parsed " << Schema::path << " ========= " << entities.size() << std::endl << std::flush;
+		for(auto& e: entities)
+			e.print();
 		process();
 	});
 }
 
+void Generator::getPartners()
+{
+	getEntities(_partners);
+}
+
 void Generator::getProductsJob()
 {
-	getArray("/ds/products", [&] (QJsonObject object) {
-		if(!object.contains("id") || !object.contains("name"))
-			throw std::runtime_error("Product JSON object is invalid");
-		const QString uuid = object.value("id").toString();
-		const QString name = object.value("name").toString();
-		_products.emplace_back(Product{ uuid, name });
-	}, [&] {
-		std::cout << "========= Parsed products ========= " << _products.size() << std::endl << std::flush;
-		for(auto& p: _products)
-			p.print();
-		process();
-	});
+	getEntities(_products);
 }
 
 void Generator::getProductsCountJob()
 {
-	const QString parameters = QString::fromUtf8(QByteArray("[{\"elementcount\": \"count(id)\"}]").toPercentEncoding());
+	const QByteArray parameters = QByteArray("[{\"elementcount\": \"count(id)\"}]").toPercentEncoding();
 
-	get("/ds/products?outputs=" + parameters, [&] (QNetworkReply* reply) {
+	_client.get("/ds/products?outputs=" + parameters, [&] (QNetworkReply* reply) {
 		const QString r = QString::fromUtf8(reply->readAll());
 		std::cout << "Get products count response: " << r.toStdString() << "END response\n";
 		process();
@@ -236,99 +203,66 @@ void Generator::deleteAllProductsJob()
 // 	std::cout << ("Deleting product " + productUuid + "\n").toStdString();
 // 	const QString condition = "[{\"field\":\"id\"},\"=\",\"" + productUuid + "\"]";
 	
-	const QString condition = "[1,\"=\",1]";
-	QNetworkRequest request(_jexiaProjectUrl + "/ds/products?cond=" + QUrl::toPercentEncoding(condition));
-	request.setRawHeader("Authorization", "Bearer " + _accessToken.toUtf8());
- 	auto reply = _nam.deleteResource(request);
-	
-	QObject::connect(reply, &QNetworkReply::finished, [&, reply] {
-		QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> r(reply);
+	const QByteArray condition = "[1,\"=\",1]";
+	_client.deleteResource("/ds/products?cond=" + condition.toPercentEncoding(), [&] (QNetworkReply*) {
 		std::cout << "Delete reply finished\n" << std::flush;
-		if(!reply->isFinished())
-			throw std::runtime_error("HTTP Reply is not finished");
-		if(reply->isRunning())
-			throw std::runtime_error("HTTP Reply is still running");
-		if(reply->error() != QNetworkReply::NoError) {
-			std::cout << "Delete all products HTTP Request failed:\n" << std::endl;
-			std::cout << QString::fromUtf8(reply->readAll()).toStdString() << std::endl << std::flush;
-			const QString errorString = reply->errorString();
-			const auto s = "Delete all products HTTP Request failed: " + QString::number(reply->error()) + errorString;
-			throw std::runtime_error(s.toStdString());
-		}
 		process();
 	});
 }
 
 void Generator::getPackageTypes()
 {
-	getArray("/ds/package_types", [&] (QJsonObject object) {
-		if(!object.contains("id") || !object.contains("name") || !object.contains("quantity"))
-			throw std::runtime_error("Package type JSON object is invalid");
-		const QString uuid = object.value("id").toString();
-		const QString name = object.value("name").toString();
-		const int quantity = object.value("quantity").toInt();
-		_packageTypes.emplace_back(PackageType{ uuid, name, quantity });
-	}, [&] {
-		std::cout << "========= Parsed package types ========= " << _packageTypes.size() << std::endl << std::flush;
-		for(auto& p: _packageTypes)
-			p.print();
-		process();
-	});
+	getEntities(_packageTypes);
 }
 
 void Generator::getPackages()
 {
-	getArray("/ds/packages", [&] (QJsonObject object) {
-		if(!object.contains("id") || !object.contains("quantity"))
-			throw std::runtime_error("Package type JSON object is invalid");
-		const QString uuid = object.value("id").toString();
-		const int quantity = object.value("quantity").toInt();
-		_packages.emplace_back(Package{ uuid, quantity });
-	}, [&] {
-		std::cout << "========= Parsed packages ========= " << _packages.size() << std::endl << std::flush;
-		for(auto& p: _packages)
-			p.print();
-		process();
-	});
+	getEntities(_packages);
 }
 
 void Generator::getShipments()
 {
-	getArray("/ds/shipments", [&] (QJsonObject object) {
-		if(!object.contains("id") || !object.contains("address"))
-			throw std::runtime_error("Shipment JSON object is invalid");
-		const QString uuid = object.value("id").toString();
-		const QString address = object.value("address").toString();
-		_shipments.emplace_back(Shipment{ uuid, address });
-	}, [&] {
-		std::cout << "========= Parsed shipments ========= " << _shipments.size() << std::endl << std::flush;
-		for(auto& s: _shipments)
-			s.print();
-		process();
-	});
+	getEntities(_shipments);
 }
 
-void Generator::post(const QString& path, const QByteArray& data, std::function<void(QNetworkReply*)> replyParser)
+// A batch that fails is only sent again when the backend turned it away as
+// a whole, for being too large or while overloaded, and a tuner can shrink it.
+template<typename T>
+void Generator::createEntities(std::shared_ptr<std::vector<T>> entities, size_t offset, std::function<void(void)> finished)
 {
-	QNetworkRequest request(_jexiaProjectUrl + path);
-	request.setRawHeader("Authorization", "Bearer " + _accessToken.toUtf8());
-	request.setHeader(QNetworkRequest::ContentTypeHeader,QVariant("application/x-www-form-urlencoded"));
-	
-	QNetworkReply* reply = _nam.post(request, data);
-	QObject::connect(reply, &QNetworkReply::finished, [replyParser, reply] {
-		QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> r(reply);
-		if(!reply->isFinished())
-			throw std::runtime_error("HTTP Reply is not finished");
-		if(reply->isRunning())
-			throw std::runtime_error("HTTP Reply is still running");
-		if(reply->error() != QNetworkReply::NoError) {
-			std::cout << "HTTP POST Request failed: \n" << std::endl;
-			std::cout << QString::fromUtf8(reply->readAll()).toStdString() << std::endl << std::flush;
-			const QString errorString = reply->errorString();
-			const auto s = "HTTP POST Request failed (" + QString::number(reply->error()) + "): " + errorString;
-			throw std::runtime_error(s.toStdString());
+	using Schema = JsonSchema::Schema<T>;
+	if(offset >= entities->size()) {
+		finished();
+		return;
+	}
+
+	BatchTuner* tuner = _autoBatch ? &_batchTuners[Schema::name] : nullptr;
+	if(tuner && offset == 0)
+		tuner->setJobRows(entities->size());
+	const size_t size = tuner ? tuner->size() : _batchSize > 0 ? _batchSize : entities->size();
+	const size_t rows = std::min(size, entities->size() - offset);
+	const auto begin = entities->begin() + std::ptrdiff_t(offset);
+
+	QByteArray data;
+	if(rows == 1)
+		JsonSchema::encode(*begin, data);
+	else
+		data = JsonSchema::encodeArray(begin, begin + std::ptrdiff_t(rows));
+
+	QElapsedTimer timer;
+	timer.start();
+	_client.post(Schema::path, data, [this, entities, offset, rows, finished, tuner, timer] (QNetworkReply*) {
+		_rowsCreated += rows;
+		if(tuner)
+			tuner->succeeded(rows, timer.elapsed());
+		createEntities(entities, offset + rows, finished);
+	}, [this, entities, offset, rows, finished, tuner] (const JexiaError& error) {
+		const int status = error.httpStatus();
+		if(tuner && (status == 413 || status == 503) && tuner->failed(rows, status == 413)) {
+			createEntities(entities, offset, finished);
+			return;
 		}
-		replyParser(reply);
+		throw error;
 	});
 }
 
@@ -336,12 +270,8 @@ void Generator::createPartnersJob(size_t count)
 {
 	const auto google = std::find_if(_partners.begin(), _partners.end(), [] (const auto& p) { return p.name == "Google"; });
 	if(google == _partners.end()) {
-		QJsonObject o {{"name", "Google"}};
-		const QByteArray data = QJsonDocument(o).toJson();
-		std::cout << QString::fromUtf8(data).toStdString() << "\n" << std::flush;
-		post("/ds/partners", data, [&] (QNetworkReply* reply) {
+		createEntities(std::make_shared<std::vector<Partner>>(1, Partner{ QString(), "Google" }), 0, [&] {
 			std::cout << "__________ Finished  ______________" << std::endl;
-//			std::cout << QString::fromUtf8(reply->readAll()).toStdString() << std::endl << std::flush;
 			process();
 		});
 	} else {
@@ -351,32 +281,20 @@ void Generator::createPartnersJob(size_t count)
 
 void Generator::createProductsJob(size_t count)
 {
-	static const QString base36 = "0123456789abcdefghijklmnopqrstuvwxyz";
-	
 	std::cout << "Creating " << count << " new products\n" << std::flush;
 
+	// Every batch gets the next stream, also when it is skipped, so the
+	// generated names only depend on the seed and the position of the batch.
+	_productStream.jump();
 	if(_products.size() < _targetProductsSize) {
-		const auto generateProduct = [&] {
-			QString name;
-			for(size_t i=0; i < 20; i++)
-				name.append(base36[_randomGenerator.bounded(0, 35)]);
-			return QJsonObject {{"name", name}};
-		};
-
-		QByteArray data;
-		if(count == 1) {
-			data = QJsonDocument(generateProduct()).toJson();
-		} else {
-			QJsonArray array;
-			for(size_t i=0; i < count; i++)
-				array.append(generateProduct());
-			data = QJsonDocument(array).toJson();
-		}
+		RandomStream random = _productStream;
+		// Names are drawn before batching, so they do not depend on the batch size
+		auto products = std::make_shared<std::vector<Product>>(count);
+		for(Product& product: *products)
+			product.name = random.base36(20);
 
-//		std::cout << QString::fromUtf8(data).toStdString() << "\n" << std::flush;
-		post("/ds/products", data, [&] (QNetworkReply* reply) {
+		createEntities(products, 0, [&] {
 			std::cout << "__________ Finished  ______________" << std::endl;
-//			std::cout << QString::fromUtf8(reply->readAll()).toStdString() << std::endl << std::flush;
 			process();
 		});
 	} else {
@@ -1,11 +1,16 @@
+#pragma once
 #include <QtGlobal>
 #include <QObject>
-#include <QNetworkAccessManager>
-#include <QEventLoop>
+#include "JexiaClient.h"
+#include <QElapsedTimer>
 #include <vector>
 #include <iostream>
-#include <QRandomGenerator>
-#include <deque>
+#include "BatchTuner.h"
+#include "RandomStream.h"
+#include "WorkQueue.h"
+#include <map>
+#include <memory>
+#include <string>
 
 class Generator : public QObject
 {
@@ -13,7 +18,16 @@ Q_OBJECT
 public:
 	Generator(const QString& jexiaProjectUrl, const QString& jexiaKey, const QString& jexiaSecret);
 	
+	// Names the project in the summary, when several run at once.
+	void setName(const QString& name);
 	void setRepetitions(size_t count);
+	void setSeed(quint64 seed);
+	// For the options of the client plumbing, see ClientOptions
+	JexiaClient& client() { return _client; }
+	// Rows per insert request, 0 sends every job as one request.
+	void setBatchSize(size_t rows);
+	// Probe for the batch size with the highest throughput, per entity.
+	void setAutoBatch(bool enabled);
 	void getProducts();
 	void getProductsCount();
 	void createPartners(size_t count);
@@ -66,15 +80,11 @@ public:
 		}
 	};
 	
-	// General HTTP GET infra
-	void run();
+	// Runs the jobs of all generators in one event loop, each against its
+	// own project, then prints the statistics of each and their totals.
+	static void run(const std::vector<Generator*>& generators);
 private:
-	const QString _jexiaProjectUrl;
-	const QString _jexiaKey;
-	const QString _jexiaSecret;
-	
-	QString _accessToken;
-	QString _refreshToken;
+	JexiaClient _client;
 	
 	size_t _repetitions = 1;
 	std::vector<Partner> _partners;
@@ -83,19 +93,28 @@ private:
 	std::vector<Package> _packages;
 	std::vector<Shipment> _shipments;
 	
-	std::deque<std::function<void(void)>> _workQueue;
+	WorkQueue _workQueue;
 	
 	quint64 _targetProductsSize = 8;
+
+	size_t _batchSize = 0;
+	bool _autoBatch = false;
+	std::map<std::string, BatchTuner> _batchTuners;
 	
-	QNetworkAccessManager _nam;
-	QEventLoop _loop;
-	QRandomGenerator _randomGenerator;
+	QString _name;
+	std::function<void(void)> _finished;
+	QElapsedTimer _clock;
+	qint64 _elapsedMs = 0;
+	size_t _rowsCreated = 0;
+	quint64 _seed;
+	bool _seedGiven = false;
+	RandomStream _productStream;
 	
-	void get(const QString& path, std::function<void(QNetworkReply*)> func);
-	void getArray(const QString& path, std::function<void(QJsonObject)> apply, std::function<void(void)> finally, size_t offset = 0);
 	void authenticate();
 	
 	// Model specific getters
+	template<typename T>
+	void getEntities(std::vector<T>& entities);
 	void getPartners();
 	void getProductsJob();
 	void getProductsCountJob();
@@ -103,13 +122,16 @@ private:
 	void getPackageTypes();
 	void getPackages();
 	void getShipments();
-	
-	// General HTTP POST infra
-	void post(const QString& path, const QByteArray& data, std::function<void(QNetworkReply*)> replyParser);
+
+	// Posts entities from offset on in batches, then calls finished
+	template<typename T>
+	void createEntities(std::shared_ptr<std::vector<T>> entities, size_t offset, std::function<void(void)> finished);
 
 	// Model specific creaters
 	void createPartnersJob(size_t count);
 	void createProductsJob(size_t count);
 	
+	void start(std::function<void(void)> finished);
 	void process();
+	void finish() const;
 };
@@ -0,0 +1,51 @@
+#pragma once
+#include "Generator.h"
+#include "JsonSchema.h"
+
+//
+// The JSON schemas of the GreenBites datasets.
+//
+namespace JsonSchema {
+
+template<> struct Schema<Generator::Partner> {
+	static constexpr const char* name = "Partner";
+	static constexpr const char* path = "/ds/partners";
+	static constexpr auto fields = std::make_tuple(
+		field("id", &Generator::Partner::uuid, Key | Generated),
+		field("name", &Generator::Partner::name, Required));
+};
+
+template<> struct Schema<Generator::Product> {
+	static constexpr const char* name = "Product";
+	static constexpr const char* path = "/ds/products";
+	static constexpr auto fields = std::make_tuple(
+		field("id", &Generator::Product::uuid, Key | Generated),
+		field("name", &Generator::Product::name, Required));
+};
+
+template<> struct Schema<Generator::PackageType> {
+	static constexpr const char* name = "Package type";
+	static constexpr const char* path = "/ds/package_types";
+	static constexpr auto fields = std::make_tuple(
+		field("id", &Generator::PackageType::uuid, Key | Generated),
+		field("name", &Generator::PackageType::name, Required),
+		field("quantity", &Generator::PackageType::quantity, Required));
+};
+
+template<> struct Schema<Generator::Package> {
+	static constexpr const char* name = "Package";
+	static constexpr const char* path = "/ds/packages";
+	static constexpr auto fields = std::make_tuple(
+		field("id", &Generator::Package::uuid, Key | Generated),
+		field("quantity", &Generator::Package::quantity, Required));
+};
+
+template<> struct Schema<Generator::Shipment> {
+	static constexpr const char* name = "Shipment";
+	static constexpr const char* path = "/ds/shipments";
+	static constexpr auto fields = std::make_tuple(
+		field("id", &Generator::Shipment::uuid, Key | Generated),
+		field("address", &Generator::Shipment::address, Required));
+};
+
+}
@@ -3,10 +3,14 @@ TEMPLATE        = app
 
 QT += network
 
-HEADERS = Generator.h
+INCLUDEPATH += $$PWD/../Common
+LIBS += -L$$OUT_PWD/../Common -lgreenbites
+PRE_TARGETDEPS += $$OUT_PWD/../Common/libgreenbites.a
+
+HEADERS = Generator.h Schemas.h
 SOURCES = main.cpp Generator.cpp
 
-CONFIG += static
+CONFIG += static c++17
 
 QMAKE_CXXFLAGS += -O3
 
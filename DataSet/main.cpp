@@ -3,8 +3,43 @@
 #include <QCoreApplication>
 #include <QProcessEnvironment>
 #include "Generator.h"
+#include "ClientOptions.h"
+#include "Tracer.h"
 #include <stdexcept>
+#include <memory>
+#include <vector>
+#include <QFile>
+#include <QUrl>
+#include <QRegularExpression>
 #include <QCommandLineParser>
+struct Project {
+	QString url;
+	QString key;
+	QString secret;
+};
+
+// One project per line: url, key and secret separated by white space.
+// Empty lines and lines starting with # are skipped.
+static std::vector<Project> readProjects(const QString& path)
+{
+	QFile file(path);
+	if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		throw std::runtime_error("Could not open projects file " + path.toStdString());
+	std::vector<Project> projects;
+	while(!file.atEnd()) {
+		const QString line = QString::fromUtf8(file.readLine()).trimmed();
+		if(line.isEmpty() || line.startsWith('#'))
+			continue;
+		const QStringList fields = line.split(QRegularExpression("\\s+"));
+		if(fields.size() != 3)
+			throw std::runtime_error("Projects file line needs url, key and secret: " + line.section(' ', 0, 0).toStdString());
+		projects.push_back(Project{ fields[0], fields[1], fields[2] });
+	}
+	if(projects.empty())
+		throw std::runtime_error("No projects in " + path.toStdString());
+	return projects;
+}
+
 //
 // The GreenBites dataset generator
 //
@@ -38,59 +73,109 @@ int main(int argc, char**argv)
 				"reps", "Repetitions", "count");
 	clParser.addOption(repetitionsArg);
 
+	QCommandLineOption batchSizeArg(
+				"batchsize", "Insert this many rows per request, or auto to find the fastest size", "rows");
+	clParser.addOption(batchSizeArg);
+
+	ClientOptions clientOptions(clParser);
+
+	QCommandLineOption projectsArg(
+				"projects", "Drive every project in this file at once, instead of the one in the environment", "path");
+	clParser.addOption(projectsArg);
+
+	QCommandLineOption seedArg(
+				"seed", "Seed for reproducible generation", "seed");
+	clParser.addOption(seedArg);
+
 	const QDateTime startTime = QDateTime::currentDateTimeUtc();
 	std::cout << "Started on " << startTime.toString().toStdString() << std::endl << std::flush;
-	auto env = QProcessEnvironment::systemEnvironment();
-
-	const auto getEnv = [&] (const QString& variable) {
-		if(!env.contains(variable)) {
-			std::cout << "Need to set " + variable.toStdString() + " in environment\n";
-			throw std::runtime_error("Environment not configured");
-		}
-		return env.value(variable);
-	};
-	const QString jexiaProjectUrl = getEnv("JEXIA_PROJECT_URL");
-	const QString jexiaKey = getEnv("JEXIA_KEY");
-	const QString jexiaSecret = getEnv("JEXIA_SECRET");
 
 	clParser.process(qapp);
-	Generator g(jexiaProjectUrl, jexiaKey, jexiaSecret);
-	
-	if(clParser.isSet(repetitionsArg)) {
-		bool ok = true;
-		const int count = clParser.value(repetitionsArg).toInt(&ok);
-		if(!ok)
-			throw std::runtime_error("Could not parse repetitions");
-		std::cout << "Set repetitions to " << count << "\n";
-		g.setRepetitions(count);
-	}
+	std::vector<Project> projects;
+	if(clParser.isSet(projectsArg)) {
+		projects = readProjects(clParser.value(projectsArg));
+	} else {
+		auto env = QProcessEnvironment::systemEnvironment();
 
-	if(clParser.isSet(getProductsCountArg)) {
-		std::cout << "Get products count job added\n";
-		g.getProductsCount();
-	}
-	if(clParser.isSet(createPartnersArg)) {
-		std::cout << "Create partners job added\n";
-		g.createPartners(10);
-	}
-	if(clParser.isSet(getProductsArg)) {
-		std::cout << "Get products job added\n";
-		g.getProducts();
-	}
-	if(clParser.isSet(createProductsArg)) {
-		bool ok = true;
-		const int count = clParser.value(createProductsArg).toInt(&ok);
-		if(!ok)
-			throw std::runtime_error("Could not parse count");
-		std::cout << "Create products job added (" << count << ")\n";
-		g.createProducts(count);
+		const auto getEnv = [&] (const QString& variable) {
+			if(!env.contains(variable)) {
+				std::cout << "Need to set " + variable.toStdString() + " in environment\n";
+				throw std::runtime_error("Environment not configured");
+			}
+			return env.value(variable);
+		};
+		projects.push_back(Project{ getEnv("JEXIA_PROJECT_URL"), getEnv("JEXIA_KEY"), getEnv("JEXIA_SECRET") });
 	}
-	if(clParser.isSet(deleteAllProductsArg)) {
-		std::cout << "Delete all products job added\n";
-		g.deleteAllProducts();
+
+	clientOptions.startTracing();
+
+	std::vector<std::unique_ptr<Generator>> generators;
+	for(size_t i = 0; i < projects.size(); i++) {
+		generators.push_back(std::make_unique<Generator>(projects[i].url, projects[i].key, projects[i].secret));
+		Generator& g = *generators.back();
+		if(projects.size() > 1)
+			g.setName(QUrl(projects[i].url).host());
+		clientOptions.apply(g.client(), projects.size() > 1 ? int(i) : -1);
+
+		if(clParser.isSet(seedArg)) {
+			bool ok = true;
+			const quint64 seed = clParser.value(seedArg).toULongLong(&ok);
+			if(!ok)
+				throw std::runtime_error("Could not parse seed");
+			g.setSeed(seed);
+		}
+
+		if(clParser.isSet(batchSizeArg)) {
+			if(clParser.value(batchSizeArg) == "auto") {
+				g.setAutoBatch(true);
+			} else {
+				bool ok = true;
+				g.setBatchSize(clParser.value(batchSizeArg).toUInt(&ok));
+				if(!ok)
+					throw std::runtime_error("Could not parse batch size");
+			}
+		}
+
+		if(clParser.isSet(repetitionsArg)) {
+			bool ok = true;
+			const int count = clParser.value(repetitionsArg).toInt(&ok);
+			if(!ok)
+				throw std::runtime_error("Could not parse repetitions");
+			std::cout << "Set repetitions to " << count << "\n";
+			g.setRepetitions(count);
+		}
+
+		if(clParser.isSet(getProductsCountArg)) {
+			std::cout << "Get products count job added\n";
+			g.getProductsCount();
+		}
+		if(clParser.isSet(createPartnersArg)) {
+			std::cout << "Create partners job added\n";
+			g.createPartners(10);
+		}
+		if(clParser.isSet(getProductsArg)) {
+			std::cout << "Get products job added\n";
+			g.getProducts();
+		}
+		if(clParser.isSet(createProductsArg)) {
+			bool ok = true;
+			const int count = clParser.value(createProductsArg).toInt(&ok);
+			if(!ok)
+				throw std::runtime_error("Could not parse count");
+			std::cout << "Create products job added (" << count << ")\n";
+			g.createProducts(count);
+		}
+		if(clParser.isSet(deleteAllProductsArg)) {
+			std::cout << "Delete all products job added\n";
+			g.deleteAllProducts();
+		}
 	}
-	
-	g.run();
+
+	std::vector<Generator*> running;
+	for(const auto& g: generators)
+		running.push_back(g.get());
+	Generator::run(running);
+	Tracer::instance().write();
 
 	std::cout << "Finished on " << startTime.toString().toStdString() << std::endl << std::flush;
 	return 0;
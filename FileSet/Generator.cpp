@@ -4,210 +4,292 @@
 #include <QNetworkReply>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QAuthenticator>
 #include <QJsonArray>
-#include <QThread>
-#include <QScopedPointer>
+#include <QRandomGenerator>
+#include <QtConcurrent>
+#include <QFile>
+#include <QElapsedTimer>
+#include "XxHash64.h"
 
 Generator::Generator(const QString& jexiaProjectUrl, const QString& jexiaKey, const QString& jexiaSecret)
-: _jexiaProjectUrl(jexiaProjectUrl)
-, _jexiaKey(jexiaKey)
-, _jexiaSecret(jexiaSecret)
-, _randomGenerator(QRandomGenerator::securelySeeded())
+: _client(jexiaProjectUrl, jexiaKey, jexiaSecret)
+, _seed(QRandomGenerator::securelySeeded().generate64())
+, _uploadStream(_seed)
 { 
-	QObject::connect(&_nam, &QNetworkAccessManager::authenticationRequired, [] {
-		std::cout << "QNetworkAccessManager::authenticationRequired - 100" << std::endl << std::flush;
-	});
-	
-	_workQueue = {
-		[&] { authenticate(); }
-	};
+	_workQueue.add("authenticate", [&] { authenticate(); });
+}
+
+void Generator::setSeed(quint64 seed)
+{
+	_seed = seed;
+	_seedGiven = true;
+	_uploadStream = RandomStream(seed);
+}
+
+void Generator::setManifest(const QString& path)
+{
+	_manifestPath = path;
 }
 
 void Generator::run()
 {
+	const quint64 seed = _client.captureSeed(_seed, _seedGiven);
+	if(seed != _seed)
+		setSeed(seed);
+	std::cout << "Seed " << _seed << std::endl << std::flush;
 	QTimer::singleShot(10, [&] { process(); });
 	_loop.exec();
+	_client.saveCapture();
+	_client.saveTlsSession();
+	_client.printStatistics();
 }
 
 void Generator::process()
 {
-	if(_workQueue.empty()) {
+	if(!_workQueue.next())
 		_loop.quit();
-		return;
-	}
-	
-	auto f = _workQueue.front();
-	_workQueue.pop_front();
-	f();
 }
 
 void Generator::authenticate()
 {
-	std::cout << "Authenticating\n" << std::flush;
+	_client.authenticate([&] { process(); });
+}
 
-	// Send an authentication request.
-	QJsonObject object {
-		{"method", "apk"},
-		{"key", _jexiaKey},
-		{"secret", _jexiaSecret},
-	};
+void Generator::uploadFiles(size_t filesize, size_t filecount)
+{
+	// description=
+	// file=
 	
-	QNetworkRequest request(_jexiaProjectUrl + "/auth");
-	request.setHeader(QNetworkRequest::ContentTypeHeader,QVariant("application/x-www-form-urlencoded"));
-	QNetworkReply* reply = _nam.post(request, QJsonDocument(object).toJson());
-	QObject::connect(reply, &QNetworkReply::finished, [this, reply] () { 
-		QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> r(reply);
-		auto doc = QJsonDocument::fromJson(reply->readAll());
-		if(!doc.isObject())
-			throw std::runtime_error("Authentication reply is not a JSON object");
-		const auto object = doc.object();
-		if(!object.contains("access_token"))
-			throw std::runtime_error("Authentication JSON object must contain access_token");
-		if(!object.contains("refresh_token"))
-			throw std::runtime_error("Authentication JSON object must contain refresh_token");
-		_accessToken = object.value("access_token").toString();
-		_refreshToken = object.value("refresh_token").toString();
-		if(_accessToken.isEmpty() || _refreshToken.isEmpty())
-			throw std::runtime_error("One of the tokens is empty");
-		std::cout << "Authenticated\n" << std::flush;
-		process();
+	_workQueue.add("uploadFiles", [&, filesize, filecount] {
+		std::cout << "UploadFilesJob started" << std::endl;
+		// The manifest describes the files uploaded by this run
+		if(!_manifestStarted) {
+			QFile manifest(_manifestPath);
+			if(!manifest.open(QIODevice::WriteOnly | QIODevice::Truncate))
+				throw std::runtime_error("Could not open manifest " + _manifestPath.toStdString());
+			_manifestStarted = true;
+		}
+		// Every job gets the next stream, the files of a job draw from it in order.
+		_uploadStream.longJump();
+		auto upload = std::make_shared<Upload>(Upload{ _uploadStream, QString(), qint64(filesize), filecount });
+		upload->prefix = "Generator_" + upload->random.base36(8) + "_";
+		uploadNext(upload);
 	});
+	std::cout << "Upload files job (" << filesize << ", " << filecount << ") added" << std::endl << std::flush;
 }
 
-QString Generator::randomString(size_t length)
+// Only a few files are generated or posted at a time, a payload is freed
+// when its POST finishes. Files are started in order, so file i always
+// draws the same part of the job's stream.
+void Generator::uploadNext(std::shared_ptr<Upload> upload)
 {
-	static const QString base36 = "0123456789abcdefghijklmnopqrstuvwxyz";
-	
-	QString result;
-	for(size_t i=0; i < length; i++)
-		result.append(base36[_randomGenerator.bounded(0, 35)]);
-	return result;
+	if(upload->inFlight == 0 && upload->next == upload->count) {
+		std::cout << "UploadFilesJob completed" << std::endl << std::flush;
+		process();
+		return;
+	}
+
+	while(upload->inFlight < uploadsInFlight && upload->next < upload->count) {
+		const size_t i = upload->next++;
+		upload->inFlight++;
+		const QString name = upload->prefix + QString::number(i);
+		randomByteArray(upload->random, size_t(upload->size), [this, upload, i, name] (const QByteArray& data, const std::vector<quint64>& checksums) {
+			const ManifestEntry entry { name, upload->size, checksums };
+			_client.post("/fs/" + name.toUtf8(), data, [this, upload, i, entry] (QNetworkReply*) {
+				std::cout << "UploadFilesJob: " << i << std::endl;
+				appendManifest(entry);
+				upload->inFlight--;
+				uploadNext(upload);
+			});
+		});
+	}
 }
 
-void Generator::get(const QString& path, std::function<void(QNetworkReply*)> replyParser)
+// Fills the payload in blocks on the thread pool, without blocking the event
+// loop. Each block draws from its own jumped stream, so the bytes do not depend
+// on the thread count, and is checksummed while it is still in cache.
+// The passed stream is advanced right away, past all the blocks, ready for the next file.
+void Generator::randomByteArray(RandomStream& random, size_t size, std::function<void(const QByteArray&, const std::vector<quint64>&)> done)
 {
-	QThread::msleep(200);
-	
-	QNetworkRequest request(_jexiaProjectUrl + path);
-	request.setRawHeader("Authorization", "Bearer " + _accessToken.toUtf8());
-	
-	QNetworkReply* reply = _nam.get(request);
-	QObject::connect(reply, &QNetworkReply::finished, [replyParser, reply] {
-		QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> r(reply);
-		if(!reply->isFinished())
-			throw std::runtime_error("HTTP Reply is not finished");
-		if(reply->isRunning())
-			throw std::runtime_error("HTTP Reply is still running");
-		if(reply->error() != QNetworkReply::NoError) {
-			std::cout << "HTTP GET Request failed: \n" << std::endl;
-			std::cout << "Url: " << reply->request().url().toString().toStdString() << "\n";
-			std::cout << QString::fromUtf8(reply->readAll()).toStdString() << std::endl << std::flush;
-			const QString errorString = reply->errorString();
-			const auto s = "HTTP GET Request failed (" + QString::number(reply->error()) + "): " + errorString;
-			throw std::runtime_error(s.toStdString());
-		}
-		replyParser(reply);
+	struct Block {
+		char* data;
+		size_t size;
+		RandomStream random;
+		quint64* checksum;
+	};
+	struct Payload {
+		QByteArray data;
+		std::vector<quint64> checksums;
+		std::vector<Block> blocks;
+	};
+
+	auto payload = std::make_shared<Payload>();
+	payload->data.resize(int(size));
+	payload->checksums.assign((size + blockSize - 1) / blockSize, 0);
+	payload->blocks.reserve(payload->checksums.size());
+	for(size_t p = 0; p < size; p += blockSize) {
+		random.jump();
+		payload->blocks.push_back(Block{ payload->data.data() + p, std::min(size_t(blockSize), size - p), random, &payload->checksums[p / blockSize] });
+	}
+	random.jump();
+
+	auto watcher = new QFutureWatcher<void>(this);
+	QObject::connect(watcher, &QFutureWatcher<void>::finished, this, [watcher, payload, done] {
+		watcher->deleteLater();
+		done(payload->data, payload->checksums);
 	});
+	watcher->setFuture(QtConcurrent::map(payload->blocks, [] (Block& block) {
+		block.random.fill(block.data, block.size);
+		*block.checksum = XxHash64::hash(block.data, block.size);
+	}));
 }
 
-// range={"limit": 5, "offset": 3}
-void Generator::getArray(const QString& path, std::function<void(QJsonObject)> apply, std::function<void(void)> finally, size_t offset)
+// One line per file: name, size and the comma separated block checksums, tab separated.
+void Generator::appendManifest(const ManifestEntry& entry) const
 {
-	std::cout << "getArray (" << path.toStdString() << ", " << offset << ")" << std::endl << std::flush;
-	
-	QString paginatePath;
-	if(offset == 0) {
-		paginatePath = path;
-	} else {
-		const QString r = "{\"limit\": 1000, \"offset\": " + QString::number(offset) + "}";
-		paginatePath = path + "?range=" + QUrl::toPercentEncoding(r);
-	}
-	
-	get(paginatePath, [&, path, apply, finally, offset] (QNetworkReply* reply) {
-		const QByteArray result = reply->readAll();
-		const auto doc = QJsonDocument::fromJson(result);
-		if(!doc.isArray())
-			throw std::runtime_error("Document is not a json array");
-		const auto array = doc.array();
-		if(!array.isEmpty()) {
-			for(const QJsonValue& element: array) {
-				if(!element.isObject())
-					throw std::runtime_error("Element is not an object");
-				apply(element.toObject());
-			}
-			// Continue with next offset
-			getArray(path, apply, finally, offset + array.size());
-		} else {
-			// If we get an empty array, we are done.
-			finally();
-		}
-	});
+	QFile file(_manifestPath);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+		throw std::runtime_error("Could not open manifest " + _manifestPath.toStdString());
+	QByteArrayList checksums;
+	for(quint64 checksum: entry.checksums)
+		checksums.append(QByteArray::number(checksum, 16));
+	file.write(entry.name.toUtf8() + "\t" + QByteArray::number(entry.size) + "\t" + checksums.join(',') + "\n");
 }
 
-void Generator::post(const QString& path, const QByteArray& data, std::function<void(QNetworkReply*)> replyParser)
+std::vector<Generator::ManifestEntry> Generator::readManifest() const
 {
-	QNetworkRequest request(_jexiaProjectUrl + path);
-	request.setRawHeader("Authorization", "Bearer " + _accessToken.toUtf8());
-	request.setHeader(QNetworkRequest::ContentTypeHeader,QVariant("application/x-www-form-urlencoded"));
-	
-	QNetworkReply* reply = _nam.post(request, data);
-	QObject::connect(reply, &QNetworkReply::finished, [replyParser, reply] {
-		QScopedPointer<QNetworkReply, QScopedPointerDeleteLater> r(reply);
-		if(!reply->isFinished())
-			throw std::runtime_error("HTTP Reply is not finished");
-		if(reply->isRunning())
-			throw std::runtime_error("HTTP Reply is still running");
-		if(reply->error() != QNetworkReply::NoError) {
-			std::cout << "HTTP POST Request failed: \n" << std::endl;
-			std::cout << QString::fromUtf8(reply->readAll()).toStdString() << std::endl << std::flush;
-			const QString errorString = reply->errorString();
-			const auto s = "HTTP POST Request failed (" + QString::number(reply->error()) + "): " + errorString;
-			throw std::runtime_error(s.toStdString());
+	QFile file(_manifestPath);
+	if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+		throw std::runtime_error("Could not open manifest " + _manifestPath.toStdString());
+	std::vector<ManifestEntry> result;
+	while(!file.atEnd()) {
+		const QByteArray line = file.readLine().trimmed();
+		if(line.isEmpty())
+			continue;
+		const QList<QByteArray> fields = line.split('\t');
+		if(fields.size() != 3)
+			throw std::runtime_error("Invalid manifest line: " + line.toStdString());
+		bool ok = true;
+		ManifestEntry entry { QString::fromUtf8(fields[0]), fields[1].toLongLong(&ok), {} };
+		if(!ok)
+			throw std::runtime_error("Invalid file size in manifest: " + line.toStdString());
+		for(const QByteArray& checksum: fields[2].split(',')) {
+			if(checksum.isEmpty())
+				continue;
+			entry.checksums.push_back(checksum.toULongLong(&ok, 16));
+			if(!ok)
+				throw std::runtime_error("Invalid checksum in manifest: " + line.toStdString());
 		}
-		replyParser(reply);
-	});
+		if(entry.checksums.size() != size_t((entry.size + blockSize - 1) / blockSize))
+			throw std::runtime_error("Block count does not match file size in manifest: " + line.toStdString());
+		result.push_back(entry);
+	}
+	return result;
 }
 
-void Generator::uploadFiles(size_t filesize, size_t filecount)
+struct Generator::Download {
+	struct Part {
+		size_t file;
+		qint64 offset;
+		qint64 length;
+	};
+
+	std::vector<ManifestEntry> files;
+	std::vector<Part> parts;
+	size_t next = 0;
+	size_t inFlight = 0;
+	size_t concurrency;
+	quint64 bytes = 0;
+	QStringList mismatches;
+	QElapsedTimer timer;
+};
+
+void Generator::downloadFiles(size_t concurrency, qint64 rangeSize)
 {
-	// description=
-	// file=
-	
-	_workQueue.emplace_back([&, filesize, filecount] {
-		std::cout << "UploadFilesJob started" << std::endl;
-		const QString r = randomString(8);
-		const QByteArray data = randomByteArray(filesize);
-		for(size_t i=0; i < filecount ;i++) {
-			const QString filename = "Generator_" + r + "_" + QString::number(i);
-			post("/fs/" + filename, data, [&] (QNetworkReply*) {
-				std::cout << "UploadFilesJob: " << i << std::endl;
-			});
+	_workQueue.add("downloadFiles", [&, concurrency, rangeSize] {
+		std::cout << "DownloadFilesJob started" << std::endl;
+		auto download = std::make_shared<Download>();
+		download->files = readManifest();
+		download->concurrency = std::max<size_t>(concurrency, 1);
+
+		// Ranges are whole blocks, so every range can be verified on its own.
+		const qint64 range = rangeSize > 0 ? (rangeSize + blockSize - 1) / blockSize * blockSize : 0;
+		for(size_t f=0; f < download->files.size(); f++) {
+			const qint64 size = download->files[f].size;
+			if(range == 0 || size <= range) {
+				download->parts.push_back(Download::Part{ f, 0, 0 });
+				continue;
+			}
+			for(qint64 offset = 0; offset < size; offset += range)
+				download->parts.push_back(Download::Part{ f, offset, std::min(range, size - offset) });
 		}
-		std::cout << "UploadFilesJob completed" << std::endl << std::flush;
+		std::cout << "Downloading " << download->files.size() << " files in " << download->parts.size() << " requests" << std::endl << std::flush;
+		download->timer.start();
+		downloadNext(download);
 	});
-	std::cout << "Upload files job (" << filesize << ", " << filecount << ") added" << std::endl << std::flush;
+	std::cout << "Download files job (" << concurrency << ", " << rangeSize << ") added" << std::endl << std::flush;
 }
 
-QByteArray Generator::randomByteArray(size_t size)
+void Generator::downloadNext(std::shared_ptr<Download> download)
 {
-	return QByteArray(size, size);
-
-	std::mt19937_64 gen(_randomGenerator.generate64());
-	std::uniform_int_distribution<uint64_t> dis;
-	QByteArray result;
-	result.resize(size);
-	
-	uint64_t p = 0;
-	uint64_t temp;
-	while((p + 7) < size) {
-		temp = dis(gen);
-		memcpy(result.data() + p, &temp, 8);
-		p += 8;
+	if(download->inFlight == 0 && download->next == download->parts.size()) {
+		const double seconds = std::max<qint64>(download->timer.elapsed(), 1) / 1000.0;
+		std::cout << "DownloadFilesJob completed: " << download->bytes << " bytes in " << seconds << " s, "
+			<< download->bytes / seconds / 1e9 << " GB/s, " << download->mismatches.size() << " mismatches" << std::endl;
+		for(const QString& mismatch: download->mismatches)
+			std::cout << "Mismatch: " << mismatch.toStdString() << "\n";
+		std::cout << std::flush;
+		process();
+		return;
 	}
-	if(p < size) {
-		temp = dis(gen);
-		memcpy(result.data() + p, &temp, size - p);
+
+	while(download->inFlight < download->concurrency && download->next < download->parts.size()) {
+		const Download::Part part = download->parts[download->next++];
+		const ManifestEntry& file = download->files[part.file];
+		const qint64 end = part.length > 0 ? part.offset + part.length : file.size;
+		download->inFlight++;
+
+		// The body is hashed block by block as it arrives, nothing is kept.
+		struct Verifier {
+			XxHash64 hash;
+			qint64 position;
+			qint64 blockFill = 0;
+			bool overrun = false;
+		};
+		auto verifier = std::make_shared<Verifier>(Verifier{ XxHash64(), part.offset });
+		const auto onData = [download, part, end, verifier] (const QByteArray& data) {
+			const ManifestEntry& file = download->files[part.file];
+			download->bytes += quint64(data.size());
+			qint64 p = 0;
+			while(p < data.size() && verifier->position < end) {
+				const qint64 n = std::min({ qint64(data.size()) - p, blockSize - verifier->blockFill, end - verifier->position });
+				verifier->hash.update(data.constData() + p, size_t(n));
+				verifier->blockFill += n;
+				verifier->position += n;
+				p += n;
+				if(verifier->blockFill == blockSize || verifier->position == file.size) {
+					const size_t block = size_t((verifier->position - 1) / blockSize);
+					if(verifier->hash.digest() != file.checksums[block])
+						download->mismatches.append(file.name + " block " + QString::number(block));
+					verifier->hash.reset();
+					verifier->blockFill = 0;
+				}
+			}
+			if(p < data.size() && !verifier->overrun) {
+				verifier->overrun = true;
+				download->mismatches.append(file.name + " has more than " + QString::number(end - part.offset) + " bytes at " + QString::number(part.offset));
+			}
+		};
+		_client.download("/fs/" + file.name.toUtf8(), part.offset, part.length, onData, [this, download, end, verifier, part] {
+			if(verifier->position != end)
+				download->mismatches.append(download->files[part.file].name + " ended at " + QString::number(verifier->position) + " instead of " + QString::number(end));
+			download->inFlight--;
+			downloadNext(download);
+		}, [this, download, part] (const JexiaError& error) {
+			// A missing or forbidden file is a mismatch, the other files are still verified
+			download->mismatches.append(download->files[part.file].name + ": " + error.reason());
+			download->inFlight--;
+			downloadNext(download);
+		});
 	}
-	return result;
 }
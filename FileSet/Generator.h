@@ -1,11 +1,11 @@
 #include <QtGlobal>
 #include <QObject>
-#include <QNetworkAccessManager>
+#include "JexiaClient.h"
 #include <QEventLoop>
 #include <vector>
 #include <iostream>
-#include <QRandomGenerator>
-#include <deque>
+#include "RandomStream.h"
+#include "WorkQueue.h"
 
 class Generator : public QObject
 {
@@ -13,35 +13,61 @@ Q_OBJECT
 public:
 	Generator(const QString& jexiaProjectUrl, const QString& jexiaKey, const QString& jexiaSecret);
 	
+	void setSeed(quint64 seed);
+	// For the options of the client plumbing, see ClientOptions
+	JexiaClient& client() { return _client; }
+	void setManifest(const QString& path);
 	void uploadFiles(size_t filesize, size_t filecount = 1);
+	void downloadFiles(size_t concurrency, qint64 rangeSize = 0);
 	
 	// General HTTP GET infra
 	void run();
 private:
-	const QString _jexiaProjectUrl;
-	const QString _jexiaKey;
-	const QString _jexiaSecret;
+	JexiaClient _client;
 	
-	QString _accessToken;
-	QString _refreshToken;
-	
-	std::deque<std::function<void(void)>> _workQueue;
+	WorkQueue _workQueue;
 	
 	quint64 _targetProductsSize = 8;
 	
-	QNetworkAccessManager _nam;
 	QEventLoop _loop;
-	QRandomGenerator _randomGenerator;
+	quint64 _seed;
+	bool _seedGiven = false;
+	RandomStream _uploadStream;
 	
-	void get(const QString& path, std::function<void(QNetworkReply*)> func);
-	void getArray(const QString& path, std::function<void(QJsonObject)> apply, std::function<void(void)> finally, size_t offset = 0);
-	void authenticate();
+	// Uploaded files and the XXH64 checksum of every block of them,
+	// so downloads can be verified block by block, in any range.
+	static constexpr qint64 blockSize = 1048576;
+	QString _manifestPath = "fileset.manifest";
+	bool _manifestStarted = false;
+	
+	struct ManifestEntry {
+		QString name;
+		qint64 size;
+		std::vector<quint64> checksums;
+	};
+	
+	// Files posted at once by an upload job, which bounds the payloads in memory
+	static const size_t uploadsInFlight = 4;
+
+	struct Upload {
+		RandomStream random;
+		QString prefix;
+		qint64 size;
+		size_t count;
+		size_t next = 0;
+		size_t inFlight = 0;
+	};
+
+	struct Download;
 	
-	// General HTTP POST infra
-	void post(const QString& path, const QByteArray& data, std::function<void(QNetworkReply*)> replyParser);
+	void authenticate();
 
 	void process();
 	
-	QString randomString(size_t length);
-	QByteArray randomByteArray(size_t size);
+	std::vector<ManifestEntry> readManifest() const;
+	void appendManifest(const ManifestEntry& entry) const;
+	void downloadNext(std::shared_ptr<Download> download);
+	void uploadNext(std::shared_ptr<Upload> upload);
+	
+	void randomByteArray(RandomStream& random, size_t size, std::function<void(const QByteArray&, const std::vector<quint64>&)> done);
 };
@@ -1,10 +1,14 @@
 NAME            = GreenBitesDataGenerator
 TEMPLATE        = app
 
-QT += network
+QT += network concurrent
+
+INCLUDEPATH += $$PWD/../Common
+LIBS += -L$$OUT_PWD/../Common -lgreenbites
+PRE_TARGETDEPS += $$OUT_PWD/../Common/libgreenbites.a
 
 HEADERS = Generator.h
 SOURCES = main.cpp Generator.cpp
 
-CONFIG += static
+CONFIG += static c++17
 
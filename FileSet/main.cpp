@@ -3,6 +3,8 @@
 #include <QCoreApplication>
 #include <QProcessEnvironment>
 #include "Generator.h"
+#include "ClientOptions.h"
+#include "Tracer.h"
 #include <stdexcept>
 #include <QCommandLineParser>
 //
@@ -18,6 +20,24 @@ int main(int argc, char**argv)
 				"uploadfiles", "Upload some files", "count");
 	clParser.addOption(uploadFilesArg);
 
+	QCommandLineOption downloadFilesArg(
+				"downloadfiles", "Download and verify the files in the manifest, this many at a time", "concurrency");
+	clParser.addOption(downloadFilesArg);
+
+	QCommandLineOption rangeSizeArg(
+				"rangesize", "Download files larger than this in parallel ranges of this size", "bytes");
+	clParser.addOption(rangeSizeArg);
+
+	QCommandLineOption manifestArg(
+				"manifest", "The file that records the checksums of uploaded files", "path");
+	clParser.addOption(manifestArg);
+
+	ClientOptions clientOptions(clParser);
+
+	QCommandLineOption seedArg(
+				"seed", "Seed for reproducible generation", "seed");
+	clParser.addOption(seedArg);
+
 	const QDateTime startTime = QDateTime::currentDateTimeUtc();
 	std::cout << "Started on " << startTime.toString().toStdString() << std::endl << std::flush;
 	auto env = QProcessEnvironment::systemEnvironment();
@@ -34,8 +54,21 @@ int main(int argc, char**argv)
 	const QString jexiaSecret = getEnv("JEXIA_SECRET");
 
 	clParser.process(qapp);
+	clientOptions.startTracing();
 	Generator g(jexiaProjectUrl, jexiaKey, jexiaSecret);
+	clientOptions.apply(g.client());
 	
+	if(clParser.isSet(seedArg)) {
+		bool ok = true;
+		const quint64 seed = clParser.value(seedArg).toULongLong(&ok);
+		if(!ok)
+			throw std::runtime_error("Could not parse seed");
+		g.setSeed(seed);
+	}
+
+	if(clParser.isSet(manifestArg))
+		g.setManifest(clParser.value(manifestArg));
+
 	if(clParser.isSet(uploadFilesArg)) {
 		const QString arg = clParser.value(uploadFilesArg);
 		bool ok = true;
@@ -59,7 +92,22 @@ int main(int argc, char**argv)
 		g.uploadFiles(filesize, filecount);
 	}
 	
+	if(clParser.isSet(downloadFilesArg)) {
+		bool ok = true;
+		const int concurrency = clParser.value(downloadFilesArg).toInt(&ok);
+		if(!ok)
+			throw std::runtime_error("Could not parse concurrency");
+		qint64 rangeSize = 0;
+		if(clParser.isSet(rangeSizeArg)) {
+			rangeSize = clParser.value(rangeSizeArg).toLongLong(&ok);
+			if(!ok)
+				throw std::runtime_error("Could not parse range size");
+		}
+		g.downloadFiles(concurrency, rangeSize);
+	}
+	
 	g.run();
+	Tracer::instance().write();
 
 	std::cout << "Finished on " << startTime.toString().toStdString() << std::endl << std::flush;
 	return 0;
@@ -0,0 +1,9 @@
+TEMPLATE        = subdirs
+
+SUBDIRS = common dataset fileset
+
+common.file = Common/common.pro
+dataset.file = DataSet/generator.pro
+dataset.depends = common
+fileset.file = FileSet/generator.pro
+fileset.depends = common